@@ -0,0 +1,614 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * PERCEPTRON TRAINER FOR BIG DATASETS
+ *
+ * The same perceptron as SimplePerceptron.ipynb, for datasets with tens of
+ * millions of rows: the data stays on disk and is read in blocks, every
+ * update works on many features at once, and several threads train side
+ * by side.
+ *
+ *   gcc -O3 -march=native perceptron.c -pthread -o perceptron
+ *   ./perceptron --generate data.npy --rows 10000000 --features 64
+ *   ./perceptron data.npy --epochs 5 --export weights.npy
+ *
+ * THE DATA FILE
+ * A NumPy .npy file of float32, one row per example: the features, then
+ * the label in the last column (1 = class 1, anything <= 0 = class 0).
+ * From the notebook:
+ *
+ *   np.save("data.npy", np.hstack([feature, target[:, None]]).astype(np.float32))
+ *
+ * The file is memory-mapped, not read: the operating system loads each
+ * block of rows when it is reached and can drop it again afterwards, so a
+ * 20 GB file trains in a few MB of memory.
+ *
+ * THE PERCEPTRON
+ * Predict 1 if w . x + bias >= 0, else 0. When the prediction is wrong,
+ * add the row to the weights (target 1) or subtract it (target 0), exactly
+ * like backward() in the notebook.
+ *
+ * The averaged perceptron (the default, --plain turns it off) returns the
+ * average of the weights after every row instead of the last ones. A
+ * single unlucky update late in training then cannot undo the rest, which
+ * makes it much steadier on data that is not perfectly separable.
+ * Averaging is done without adding up the weights after every row, see
+ * train_rows().
+ *
+ * THREADS: ITERATIVE PARAMETER MIXING
+ * Each thread gets its own share of the rows and its own copy of the
+ * weights. In every epoch each thread trains on its share, starting from
+ * the same weights; at the end of the epoch the copies are averaged, and
+ * that average is where all threads start the next epoch. On separable data
+ * this still finds a separating line (McDonald, Hall and Mann, 2010).
+ */
+
+#define BLOCK_ROWS 65536   // rows per block: read, trained on, let go
+#define MAX_THREADS 256
+
+typedef struct {
+    const float *rows;     // rows * stride floats
+    long long count;
+    int features;
+    int stride;            // features + 1 (the label)
+    void *map;
+    size_t map_bytes;
+} Dataset;
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// splitmix64: small random numbers that can be replayed from a seed
+static uint64_t mix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/*
+ * NPY FILES
+ * A .npy file is a short text header describing the array, then the
+ * numbers. Only what this program writes and needs is understood:
+ * little-endian float32 ('<f4'), C order, two dimensions.
+ */
+int open_npy(const char *path, Dataset *ds)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(path);
+        return 0;
+    }
+
+    char head[4096];
+    ssize_t got = pread(fd, head, sizeof(head) - 1, 0);
+    if (got < 10 || memcmp(head, "\x93NUMPY", 6) != 0)
+    {
+        fprintf(stderr, "%s: not a .npy file\n", path);
+        close(fd);
+        return 0;
+    }
+    head[got] = 0;
+
+    // version 1 stores the header length in 2 bytes, versions 2 and 3 in 4
+    size_t header_len = (uint8_t)head[8] | (uint8_t)head[9] << 8;
+    if (head[6] != 1)
+        header_len |= (size_t)(uint8_t)head[10] << 16 | (size_t)(uint8_t)head[11] << 24;
+    size_t data_start = (head[6] == 1 ? 10 : 12) + header_len;
+    long long rows = 0, cols = 0;
+    const char *dict = head + 10;   // the magic string and version have zero bytes
+    const char *shape = strstr(dict, "'shape'");
+
+    if (!strstr(dict, "'<f4'") || strstr(dict, "'fortran_order': True") || !shape ||
+        sscanf(strchr(shape, '('), "(%lld, %lld)", &rows, &cols) != 2 || cols < 2 ||
+        data_start + (size_t)rows * cols * sizeof(float) > (size_t)st.st_size)
+    {
+        fprintf(stderr, "%s: expected a 2-d float32 array, features then label in each row\n"
+                        "(in NumPy: np.save(path, array.astype(np.float32)))\n", path);
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror(path);
+        return 0;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    ds->map = map;
+    ds->map_bytes = st.st_size;
+    ds->rows = (const float *)((const char *)map + data_start);
+    ds->count = rows;
+    ds->stride = (int)cols;
+    ds->features = (int)cols - 1;
+    return 1;
+}
+
+// write the header of a float array of the given shape; cols 0 = one dimension
+int write_npy_header(FILE *f, const char *descr, long long rows, long long cols)
+{
+    char dict[128];
+    if (cols)
+        snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%lld, %lld), }",
+                 descr, rows, cols);
+    else
+        snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%lld,), }",
+                 descr, rows);
+
+    // pad with spaces so the numbers start on a 64-byte boundary, end with a newline
+    size_t len = strlen(dict);
+    size_t total = (10 + len + 1 + 63) / 64 * 64;
+    uint16_t header_len = (uint16_t)(total - 10);
+
+    fwrite("\x93NUMPY\x01\x00", 1, 8, f);
+    fwrite(&header_len, 2, 1, f);
+    fwrite(dict, 1, len, f);
+    for (size_t k = 10 + len; k < total - 1; k++)
+        fputc(' ', f);
+    fputc('\n', f);
+    return !ferror(f);
+}
+
+/*
+ * generate
+ * A made-up dataset for trying things out: features uniform in [-1, 1],
+ * label 1 when they fall on the positive side of a random line, and a
+ * fraction noise of the labels flipped. With a test path, a tenth as many
+ * rows again go there, labelled by the same line.
+ */
+static int write_rows(const char *path, long long rows, int features, const float *truth, double noise, uint64_t *s)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return 0;
+    }
+    write_npy_header(f, "<f4", rows, features + 1);
+
+    float row[features + 1];
+    for (long long r = 0; r < rows; r++)
+    {
+        float dot = truth[features];
+        for (int j = 0; j < features; j++)
+        {
+            row[j] = (float)(((*s = mix64(*s)) >> 11) * 0x1.0p-53 * 2.0 - 1.0);
+            dot += truth[j] * row[j];
+        }
+        int label = dot >= 0.0f;
+        if (((*s = mix64(*s)) >> 11) * 0x1.0p-53 < noise)
+            label = !label;
+        row[features] = (float)label;
+        fwrite(row, sizeof(float), features + 1, f);
+    }
+
+    if (fclose(f) != 0)
+    {
+        perror(path);
+        return 0;
+    }
+    printf("Wrote %lld rows of %d features to %s\n", rows, features, path);
+    return 1;
+}
+
+int generate(const char *path, const char *test_path, long long rows, int features, double noise, uint64_t seed)
+{
+    float truth[features + 1];   // the line, its offset last
+    uint64_t s = mix64(seed);
+
+    for (int j = 0; j < features; j++)
+        truth[j] = (float)(((s = mix64(s)) >> 11) * 0x1.0p-53 * 2.0 - 1.0);
+    truth[features] = 0.1f;
+
+    return write_rows(path, rows, features, truth, noise, &s) &&
+           (!test_path || write_rows(test_path, rows / 10 + 1, features, truth, noise, &s));
+}
+
+/*
+ * TRAINING ONE BLOCK
+ *
+ * w holds the features' weights and then the bias, w[features]. The dot
+ * product is summed in 16 separate lanes so the compiler can keep them in
+ * vector registers (a single running sum would force one add at a time).
+ * The update loops have no dependency between features at all.
+ *
+ * Averaging: the average of the weights after rows 1..n of a block, given
+ * the weights start at w0, is
+ *     ((n + 1) w_n - w0 - u) / n,    u = sum over updates of k * (row k's change)
+ * so each update also adds k times its change to u, and nothing has to be
+ * done for rows without a mistake. train_rows() returns the mistakes;
+ * the caller folds the block's sum into a double precision total.
+ *
+ * PERCEPTRON_CLONES compiles this function once per instruction set and
+ * lets the program pick the best one for the CPU when it starts.
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define PERCEPTRON_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define PERCEPTRON_CLONES
+#endif
+
+#define LANES 16
+
+PERCEPTRON_CLONES
+long long train_rows(const float *rows, long long n, int d, int stride, float *restrict w, float *restrict u)
+{
+    long long mistakes = 0;
+
+    for (long long k = 0; k < n; k++)
+    {
+        const float *x = rows + k * stride;
+        float lane[LANES] = { 0 };
+        int j = 0;
+
+        for (; j + LANES <= d; j += LANES)
+            for (int l = 0; l < LANES; l++)
+                lane[l] += w[j + l] * x[j + l];
+        float dot = w[d];
+        for (int l = 0; l < LANES; l++)
+            dot += lane[l];
+        for (; j < d; j++)
+            dot += w[j] * x[j];
+
+        int predicted = dot >= 0.0f;
+        int target = x[d] > 0.0f;
+        if (predicted == target)
+            continue;
+
+        float step = target ? 1.0f : -1.0f;     // error = target - prediction
+        float weighted = step * (float)(k + 1);
+        for (j = 0; j < d; j++)
+        {
+            w[j] += step * x[j];
+            u[j] += weighted * x[j];
+        }
+        w[d] += step;
+        u[d] += weighted;
+        mistakes++;
+    }
+    return mistakes;
+}
+
+PERCEPTRON_CLONES
+long long count_errors(const float *rows, long long n, int d, int stride, const float *restrict w)
+{
+    long long errors = 0;
+
+    for (long long k = 0; k < n; k++)
+    {
+        const float *x = rows + k * stride;
+        float lane[LANES] = { 0 };
+        int j = 0;
+
+        for (; j + LANES <= d; j += LANES)
+            for (int l = 0; l < LANES; l++)
+                lane[l] += w[j + l] * x[j + l];
+        float dot = w[d];
+        for (int l = 0; l < LANES; l++)
+            dot += lane[l];
+        for (; j < d; j++)
+            dot += w[j] * x[j];
+
+        errors += (dot >= 0.0f) != (x[d] > 0.0f);
+    }
+    return errors;
+}
+
+/*
+ * THREADS
+ * Thread t owns rows [first, last). Within an epoch it visits its blocks in
+ * a shuffled order (rows inside a block stay in file order, so the disk is
+ * still read in long runs), asks for the next block ahead of time and
+ * gives each block back to the operating system when done with it.
+ */
+typedef struct {
+    const Dataset *ds;
+    long long first, last;
+    int epoch, average;
+    uint64_t seed;
+
+    float *w;            // starts as the mixed weights, ends as this thread's
+    float *u;
+    float *w0;           // weights at the start of the block, for the average
+    double *sum;         // sum of the weights after every row, averaged perceptron
+    long long mistakes;
+    long long errors;    // count_errors() result
+} Worker;
+
+static void release_rows(const Dataset *ds, const float *start, long long n)
+{
+    // whole pages only: the rows of the next block may share the last one
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t from = ((uintptr_t)start + page - 1) & ~(page - 1);
+    uintptr_t to = (uintptr_t)(start + n * ds->stride) & ~(page - 1);
+    if (to > from)
+        madvise((void *)from, to - from, MADV_DONTNEED);
+}
+
+static void *train_thread(void *p)
+{
+    Worker *wk = p;
+    const Dataset *ds = wk->ds;
+    int d = ds->features, width = d + 1;
+    long long blocks = (wk->last - wk->first + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    long long *order = malloc((blocks ? blocks : 1) * sizeof(long long));
+
+    // Fisher-Yates shuffle of the block order, different every epoch
+    uint64_t s = mix64(wk->seed ^ mix64(wk->epoch) ^ mix64(wk->first));
+    for (long long b = 0; b < blocks; b++)
+        order[b] = b;
+    for (long long b = blocks - 1; b > 0; b--)
+    {
+        long long c = (long long)((s = mix64(s)) % (uint64_t)(b + 1));
+        long long t = order[b]; order[b] = order[c]; order[c] = t;
+    }
+
+    for (long long b = 0; b < blocks; b++)
+    {
+        long long start = wk->first + order[b] * BLOCK_ROWS;
+        long long n = wk->last - start < BLOCK_ROWS ? wk->last - start : BLOCK_ROWS;
+        const float *rows = ds->rows + start * ds->stride;
+
+        if (b + 1 < blocks)
+        {
+            long long next = wk->first + order[b + 1] * BLOCK_ROWS;
+            madvise((void *)((uintptr_t)(ds->rows + next * ds->stride) & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1)),
+                    (size_t)BLOCK_ROWS * ds->stride * sizeof(float), MADV_WILLNEED);
+        }
+
+        if (wk->average)
+        {
+            memcpy(wk->w0, wk->w, width * sizeof(float));
+            memset(wk->u, 0, width * sizeof(float));
+        }
+        wk->mistakes += train_rows(rows, n, d, ds->stride, wk->w, wk->u);
+        if (wk->average)
+            for (int j = 0; j < width; j++)
+                wk->sum[j] += (double)(n + 1) * wk->w[j] - wk->w0[j] - wk->u[j];
+
+        release_rows(ds, rows, n);
+    }
+
+    free(order);
+    return NULL;
+}
+
+static void *test_thread(void *p)
+{
+    Worker *wk = p;
+    const Dataset *ds = wk->ds;
+
+    for (long long start = wk->first; start < wk->last; start += BLOCK_ROWS)
+    {
+        long long n = wk->last - start < BLOCK_ROWS ? wk->last - start : BLOCK_ROWS;
+        const float *rows = ds->rows + start * ds->stride;
+        wk->errors += count_errors(rows, n, ds->features, ds->stride, wk->w);
+        release_rows(ds, rows, n);
+    }
+    return NULL;
+}
+
+// run fn on every worker at once, or in this thread when there is only one
+void run_workers(Worker *wk, int threads, void *(*fn)(void *))
+{
+    pthread_t id[MAX_THREADS];
+    int started[MAX_THREADS];
+
+    if (threads == 1)
+    {
+        fn(&wk[0]);
+        return;
+    }
+    for (int t = 0; t < threads; t++)
+        if (!(started[t] = pthread_create(&id[t], NULL, fn, &wk[t]) == 0))
+            fn(&wk[t]);
+    for (int t = 0; t < threads; t++)
+        if (started[t])
+            pthread_join(id[t], NULL);
+}
+
+// fraction of ds that w gets wrong
+double error_rate(const Dataset *ds, const float *w, int threads)
+{
+    Worker wk[MAX_THREADS];
+    long long errors = 0;
+
+    if (threads > ds->count)
+        threads = ds->count > 0 ? (int)ds->count : 1;
+    for (int t = 0; t < threads; t++)
+        wk[t] = (Worker){ .ds = ds, .first = ds->count * t / threads, .last = ds->count * (t + 1) / threads,
+                          .w = (float *)w };
+    run_workers(wk, threads, test_thread);
+    for (int t = 0; t < threads; t++)
+        errors += wk[t].errors;
+    return ds->count ? (double)errors / ds->count : 0.0;
+}
+
+/*
+ * export_weights
+ * The weights then the bias as one float64 .npy array, for the notebook:
+ *   w = np.load("weights.npy"); p.weights, p.bias = list(w[:-1]), w[-1]
+ */
+int export_weights(const char *path, const float *w, int width)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return 0;
+    }
+    write_npy_header(f, "<f8", width, 0);
+    for (int j = 0; j < width; j++)
+    {
+        double v = w[j];
+        fwrite(&v, sizeof(v), 1, f);
+    }
+    return fclose(f) == 0;
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s DATA.npy [--epochs N] [--threads N] [--plain] [--seed S]\n"
+            "          [--test TEST.npy] [--export WEIGHTS.npy]\n"
+            "       %s --generate DATA.npy [--test TEST.npy] [--rows N] [--features N] [--noise P] [--seed S]\n",
+            name, name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *data_path = NULL, *generate_path = NULL, *test_path = NULL, *export_path = NULL;
+    int epochs = 5, threads = 0, average = 1, features = 32;
+    long long rows = 1000000;
+    double noise = 0.0;
+    uint64_t seed = 1;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--epochs") == 0 && a + 1 < argc) epochs = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) threads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--plain") == 0) average = 0;
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) seed = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--test") == 0 && a + 1 < argc) test_path = argv[++a];
+        else if (strcmp(argv[a], "--export") == 0 && a + 1 < argc) export_path = argv[++a];
+        else if (strcmp(argv[a], "--generate") == 0 && a + 1 < argc) generate_path = argv[++a];
+        else if (strcmp(argv[a], "--rows") == 0 && a + 1 < argc) rows = atoll(argv[++a]);
+        else if (strcmp(argv[a], "--features") == 0 && a + 1 < argc) features = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--noise") == 0 && a + 1 < argc) noise = atof(argv[++a]);
+        else if (argv[a][0] != '-' && !data_path) data_path = argv[a];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (generate_path)
+        return rows > 0 && features > 0 && generate(generate_path, test_path, rows, features, noise, seed) ? 0 : 1;
+
+    Dataset ds, test;
+    if (!data_path || epochs < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!open_npy(data_path, &ds) || (test_path && !open_npy(test_path, &test)))
+        return 1;
+    if (test_path && test.features != ds.features)
+    {
+        fprintf(stderr, "%s has %d features, %s has %d\n", test_path, test.features, data_path, ds.features);
+        return 1;
+    }
+
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (threads > ds.count) threads = (int)ds.count;
+    if (threads < 1) threads = 1;
+
+    int width = ds.features + 1;
+    float *mixed = calloc(width, sizeof(float));
+    float *result = calloc(width, sizeof(float));
+    double *total_sum = calloc(width, sizeof(double));
+    Worker wk[MAX_THREADS];
+
+    for (int t = 0; t < threads; t++)
+    {
+        wk[t] = (Worker){ .ds = &ds, .first = ds.count * t / threads, .last = ds.count * (t + 1) / threads,
+                          .average = average, .seed = seed };
+        wk[t].w = calloc(width, sizeof(float));
+        wk[t].u = calloc(width, sizeof(float));
+        wk[t].w0 = calloc(width, sizeof(float));
+        wk[t].sum = calloc(width, sizeof(double));
+    }
+
+    printf("%lld rows, %d features, %s perceptron, %d thread%s\n", ds.count, ds.features,
+           average ? "averaged" : "plain", threads, threads == 1 ? "" : "s");
+
+    double train_start = now_seconds();
+    for (int e = 0; e < epochs; e++)
+    {
+        double start = now_seconds();
+        long long mistakes = 0;
+
+        for (int t = 0; t < threads; t++)
+        {
+            memcpy(wk[t].w, mixed, width * sizeof(float));
+            wk[t].epoch = e;
+            wk[t].mistakes = 0;
+        }
+        run_workers(wk, threads, train_thread);
+
+        // mix: every thread starts the next epoch from the average of all of them
+        for (int j = 0; j < width; j++)
+        {
+            double s = 0.0;
+            for (int t = 0; t < threads; t++)
+                s += wk[t].w[j];
+            mixed[j] = (float)(s / threads);
+        }
+        for (int t = 0; t < threads; t++)
+            mistakes += wk[t].mistakes;
+
+        double took = now_seconds() - start;
+        printf("Epoch %d: %.3f%% mistakes, %.2f s, %.1f M rows/s\n", e + 1,
+               100.0 * mistakes / ds.count, took, ds.count / took / 1e6);
+    }
+    double train_time = now_seconds() - train_start;
+
+    // the averaged perceptron's weights: the mean of the weights after every row seen
+    if (average)
+        for (int j = 0; j < width; j++)
+        {
+            for (int t = 0; t < threads; t++)
+                total_sum[j] += wk[t].sum[j];
+            result[j] = (float)(total_sum[j] / ((double)ds.count * epochs));
+        }
+    else
+        memcpy(result, mixed, width * sizeof(float));
+
+    printf("Trained %lld rows in %.2f s: %.1f M rows/s\n", ds.count * epochs, train_time,
+           ds.count * epochs / train_time / 1e6);
+    printf("Training error: %.3f%%\n", 100.0 * error_rate(&ds, result, threads));
+    if (test_path)
+        printf("Test error: %.3f%%\n", 100.0 * error_rate(&test, result, threads));
+
+    int ok = 1;
+    if (export_path && (ok = export_weights(export_path, result, width)))
+        printf("Weights written to %s (last entry is the bias)\n", export_path);
+
+    for (int t = 0; t < threads; t++)
+    {
+        free(wk[t].w);
+        free(wk[t].u);
+        free(wk[t].w0);
+        free(wk[t].sum);
+    }
+    free(mixed);
+    free(result);
+    free(total_sum);
+    munmap(ds.map, ds.map_bytes);
+    if (test_path)
+        munmap(test.map, test.map_bytes);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+"""
+benchmark.py
+~~~~~~~~~~~~
+
+How many images per second does TinyCNN train on: one at a time with
+train_one (what main.py does), or a mini-batch at a time with train_batch?
+
+Both are run on main.py's 8x8 dataset and on the same patterns drawn at
+28x28, the size of an MNIST digit.
+
+    python benchmark.py
+    python benchmark.py --batch-size 32 --threads 4 --epochs 5
+"""
+
+import argparse
+import os
+import time
+import tracemalloc
+
+import numpy as np
+
+from cnn import TinyCNN
+from main import make_dataset
+
+
+def split(size):
+    """main.py's dataset at the given image size, split 80/20 like main.py does."""
+    images, labels = make_dataset(size=size)
+    cut = int(len(labels) * 0.8)
+    return images[:cut], labels[:cut], images[cut:], labels[cut:]
+
+
+def run_per_sample(network, images, labels, epochs):
+    """main.py's training loop. Returns the seconds it took and the last epoch's loss."""
+    start = time.perf_counter()
+    for epoch in range(epochs):
+        total_loss = 0.0
+        order = np.random.default_rng(epoch).permutation(len(labels))
+        for index in order:
+            total_loss += network.train_one(images[index], labels[index])
+    return time.perf_counter() - start, total_loss / len(labels)
+
+
+def run_batched(network, images, labels, epochs, batch_size, threads):
+    """The same epochs, a mini-batch at a time."""
+    batch_images = np.empty((batch_size,) + images.shape[1:])
+    batch_labels = np.empty(batch_size, dtype=labels.dtype)
+
+    start = time.perf_counter()
+    for epoch in range(epochs):
+        total_loss = 0.0
+        order = np.random.default_rng(epoch).permutation(len(labels))
+        for first in range(0, len(order), batch_size):
+            picked = order[first : first + batch_size]
+            count = len(picked)
+            # Gather the batch into buffers made once, like the network's own.
+            np.take(images, picked, axis=0, out=batch_images[:count])
+            np.take(labels, picked, out=batch_labels[:count])
+            total_loss += network.train_batch(batch_images[:count], batch_labels[:count], threads)
+    return time.perf_counter() - start, total_loss / len(labels)
+
+
+def bytes_per_image(step, images):
+    """
+    Memory newly taken while step() trains on that many images, after a first
+    call to warm up. For train_batch this is only NumPy's own scratch space
+    for strided and broadcast operations, never new arrays.
+    """
+    step()
+    tracemalloc.start()
+    step()
+    peak = tracemalloc.get_traced_memory()[1]
+    tracemalloc.stop()
+    return peak // images
+
+
+def report(name, network, seconds, loss, images_trained, test_images, test_labels, memory):
+    accuracy = network.evaluate(test_images, test_labels)
+    print(
+        f"  {name:24s} {images_trained / seconds:10.0f} images/s"
+        f"   loss {loss:.4f}   accuracy {accuracy:7.2%}   {memory:6d} bytes/image"
+    )
+    return images_trained / seconds
+
+
+def benchmark(size, args):
+    train_images, train_labels, test_images, test_labels = split(size)
+    images_trained = len(train_labels) * args.epochs
+    batch_learning_rate = args.learning_rate * args.batch_size
+    print(f"{size}x{size} images, {len(train_labels)} to train on, {args.epochs} epochs")
+
+    network = TinyCNN(learning_rate=args.learning_rate, image_size=size)
+    memory = bytes_per_image(lambda: network.train_one(train_images[0], train_labels[0]), 1)
+    network = TinyCNN(learning_rate=args.learning_rate, image_size=size)
+    seconds, loss = run_per_sample(network, train_images, train_labels, args.epochs)
+    baseline = report("train_one", network, seconds, loss, images_trained, test_images, test_labels, memory)
+
+    thread_counts = [1] if args.threads == 1 else [1, args.threads]
+    for threads in thread_counts:
+        batch = (train_images[: args.batch_size], train_labels[: args.batch_size])
+        network = TinyCNN(learning_rate=batch_learning_rate, image_size=size)
+        memory = bytes_per_image(lambda: network.train_batch(*batch, threads), args.batch_size)
+
+        network = TinyCNN(learning_rate=batch_learning_rate, image_size=size)
+        seconds, loss = run_batched(
+            network, train_images, train_labels, args.epochs, args.batch_size, threads
+        )
+        name = f"train_batch, {threads} thread{'s' if threads > 1 else ''}"
+        speed = report(name, network, seconds, loss, images_trained, test_images, test_labels, memory)
+        print(f"  {'':24s} {speed / baseline:10.1f}x train_one")
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("--batch-size", type=int, default=16)
+    parser.add_argument("--threads", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--epochs", type=int, default=3)
+    parser.add_argument(
+        "--learning-rate",
+        type=float,
+        default=0.01,
+        help="per image; train_batch steps by this times the batch size",
+    )
+    args = parser.parse_args()
+
+    print(f"Mini-batches of {args.batch_size}, up to {args.threads} threads\n")
+    for size in (8, 28):
+        benchmark(size, args)
+
+
+if __name__ == "__main__":
+    main()
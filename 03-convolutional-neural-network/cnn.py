@@ -5,9 +5,11 @@ cnn.py
 A tiny convolutional neural network made from our own layers in layers.py.
 """
 
+from concurrent.futures import ThreadPoolExecutor
+
 import numpy as np
 
-from layers import Conv2D, Dense, Flatten, MaxPool2D, ReLU, SoftmaxCrossEntropy
+from layers import Arena, Conv2D, Dense, Flatten, MaxPool2D, ReLU, SoftmaxCrossEntropy
 
 
 class TinyCNN:
@@ -16,17 +18,35 @@ class TinyCNN:
 
     Shape flow:
     8x8 image -> 6x6x4 features -> 3x3x4 pooled features -> 36 values -> 3 scores
+
+    Bigger images work too: a 28x28 image gives 26x26x4 features, 13x13x4
+    pooled features and 676 values.
     """
 
-    def __init__(self, learning_rate=0.01):
+    def __init__(self, learning_rate=0.01, image_size=8):
+        self.image_size = image_size
+        self.num_classes = 3
+
         # Four filters means the network can learn four small visual detectors.
         self.conv = Conv2D(num_filters=4, filter_size=3, learning_rate=learning_rate)
         self.relu = ReLU()
         self.pool = MaxPool2D(pool_size=2)
         self.flatten = Flatten()
-        self.dense = Dense(input_len=3 * 3 * 4, output_len=3, learning_rate=learning_rate)
+
+        self.feature_size = image_size - self.conv.filter_size + 1
+        self.pooled_size = self.feature_size // self.pool.pool_size
+        self.dense = Dense(
+            input_len=self.pooled_size * self.pooled_size * self.conv.num_filters,
+            output_len=self.num_classes,
+            learning_rate=learning_rate,
+        )
         self.loss = SoftmaxCrossEntropy()
 
+        # Batched training: the workspaces for each batch size, and the threads.
+        self.workspaces = {}
+        self.pool_threads = 0
+        self.executor = None
+
     def forward(self, image):
         """Run one image through every layer and return raw class scores."""
         output = self.conv.forward(image)
@@ -59,3 +79,134 @@ class TinyCNN:
         """Measure accuracy on a small set of images."""
         predictions = [self.predict(image) for image in images]
         return np.mean(np.array(predictions) == labels)
+
+    # ------------------------------------------------------------------
+    # Batched training
+    #
+    # train_one is easy to follow but slow: Python loops over every pixel, and
+    # new arrays on every call. train_batch does the same math for a whole
+    # mini-batch at once, in buffers that are made once and then reused.
+    # ------------------------------------------------------------------
+
+    def make_workspace(self, batch_size):
+        """
+        Every array one batch of batch_size images needs, forward and backward,
+        in one Arena.
+        """
+        size = self.feature_size
+        pooled = self.pooled_size
+        filters = self.conv.num_filters
+        region = self.conv.filter_size * self.conv.filter_size
+
+        workspace = Arena([
+            # forward
+            ("patches", (batch_size * size * size, region), np.float64),
+            ("features", (batch_size, size, size, filters), np.float64),
+            ("active", (batch_size, size, size, filters), np.bool_),
+            ("activated", (batch_size, size, size, filters), np.float64),
+            ("pooled", (batch_size, pooled, pooled, filters), np.float64),
+            ("logits", (batch_size, self.num_classes), np.float64),
+            ("probabilities", (batch_size, self.num_classes), np.float64),
+            ("row", (batch_size, 1), np.float64),
+            ("row_start", (batch_size,), np.int64),
+            ("label_index", (batch_size,), np.int64),
+            ("picked", (batch_size,), np.float64),
+            # backward
+            ("d_logits", (batch_size, self.num_classes), np.float64),
+            ("d_flat", (batch_size, pooled * pooled * filters), np.float64),
+            ("is_max", (batch_size, pooled, pooled, filters), np.bool_),
+            ("d_activated", (batch_size, size, size, filters), np.float64),
+            ("d_features", (batch_size, size, size, filters), np.float64),
+            # this batch's share of the parameter gradients
+            ("d_filters", self.conv.filters.shape, np.float64),
+            ("d_conv_biases", self.conv.biases.shape, np.float64),
+            ("d_weights", self.dense.weights.shape, np.float64),
+            ("d_dense_biases", self.dense.biases.shape, np.float64),
+        ])
+        workspace.row_start[:] = np.arange(batch_size) * self.num_classes
+        return workspace
+
+    def gradients_batch(self, images, labels, workspace):
+        """
+        Forward and backward for a batch, without touching the weights.
+        The summed gradients end up in workspace; returns the summed loss.
+        """
+        w = workspace
+
+        output = self.conv.forward_batch(images, w.patches, w.features)
+        output = self.relu.forward_batch(output, w.activated, w.active)
+        output = self.pool.forward_batch(output, w.pooled)
+        output = self.flatten.forward_batch(output)
+        logits = self.dense.forward_batch(output, w.logits)
+        loss = self.loss.forward_batch(
+            logits, labels, w.probabilities, w.row, w.row_start, w.label_index, w.picked
+        )
+
+        gradient = self.loss.backward_batch(w.probabilities, w.label_index, w.picked, w.d_logits)
+        gradient = self.dense.backward_batch(
+            gradient, output, w.d_weights, w.d_dense_biases, w.d_flat
+        )
+        gradient = self.flatten.backward_batch(gradient, w.pooled.shape)
+        gradient = self.pool.backward_batch(w.activated, w.pooled, gradient, w.d_activated, w.is_max)
+        gradient = self.relu.backward_batch(gradient, w.active, w.d_features)
+        self.conv.backward_batch(gradient, w.patches, w.d_filters, w.d_conv_biases)
+
+        return loss
+
+    def train_batch(self, images, labels, threads=1):
+        """
+        Train on a mini-batch of images (batch, height, width): one gradient
+        descent step with the average gradient of the batch. Returns the
+        summed loss, so it adds up the same way as train_one's losses.
+
+        With threads > 1 the batch is split into that many parts. Each thread
+        works out its part's gradients in its own workspace, then the parts
+        are added together and the weights take one step. NumPy lets go of
+        Python's lock inside its array operations, so the threads can really
+        run at the same time.
+        """
+        batch_size = len(labels)
+        threads = max(1, min(threads, batch_size))
+        bounds = [batch_size * part // threads for part in range(threads + 1)]
+
+        # One workspace per part, made the first time this batch size is seen.
+        key = (batch_size, threads)
+        if key not in self.workspaces:
+            self.workspaces[key] = [
+                self.make_workspace(bounds[part + 1] - bounds[part]) for part in range(threads)
+            ]
+        workspaces = self.workspaces[key]
+
+        if threads == 1:
+            loss = self.gradients_batch(images, labels, workspaces[0])
+        else:
+            if self.pool_threads < threads:
+                if self.executor is not None:
+                    self.executor.shutdown()
+                self.executor = ThreadPoolExecutor(max_workers=threads)
+                self.pool_threads = threads
+
+            jobs = [
+                self.executor.submit(
+                    self.gradients_batch,
+                    images[bounds[part] : bounds[part + 1]],
+                    labels[bounds[part] : bounds[part + 1]],
+                    workspaces[part],
+                )
+                for part in range(threads)
+            ]
+            loss = sum(job.result() for job in jobs)
+
+            # Reduction: add every part's gradients into the first part's.
+            total = workspaces[0]
+            for part in workspaces[1:]:
+                total.d_filters += part.d_filters
+                total.d_conv_biases += part.d_conv_biases
+                total.d_weights += part.d_weights
+                total.d_dense_biases += part.d_dense_biases
+
+        total = workspaces[0]
+        self.conv.apply_gradients(total.d_filters, total.d_conv_biases, 1.0 / batch_size)
+        self.dense.apply_gradients(total.d_weights, total.d_dense_biases, 1.0 / batch_size)
+
+        return loss
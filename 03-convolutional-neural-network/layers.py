@@ -9,6 +9,32 @@ The code favors readability over speed, so each operation is easy to inspect.
 import numpy as np
 
 
+class Arena:
+    """
+    One block of memory, cut into named arrays once and reused for every batch.
+
+    The batched methods below never create arrays of their own. They write
+    into buffers the caller passes in, and an Arena is where those buffers
+    live: a list of (name, shape, dtype) becomes one allocation, and each
+    name becomes an attribute that is a view into it.
+    """
+
+    def __init__(self, buffers):
+        offsets = []
+        total = 0
+        for name, shape, dtype in buffers:
+            # Start every buffer on a 64-byte cache line.
+            total = -(-total // 64) * 64
+            offsets.append(total)
+            total += int(np.prod(shape)) * np.dtype(dtype).itemsize
+
+        self.memory = np.zeros(total, dtype=np.uint8)
+        for (name, shape, dtype), offset in zip(buffers, offsets):
+            size = int(np.prod(shape)) * np.dtype(dtype).itemsize
+            view = self.memory[offset : offset + size].view(dtype).reshape(shape)
+            setattr(self, name, view)
+
+
 class Conv2D:
     """
     A simple 2D convolution layer for one grayscale image.
@@ -95,6 +121,52 @@ class Conv2D:
 
         return d_loss_d_input
 
+    def forward_batch(self, images, patches, output):
+        """
+        Run a batch of images (batch, height, width) through the layer at once.
+
+        patches gets every filter-sized region of every image as one row, so all filters
+        meet all regions in a single matrix multiply instead of a Python loop.
+        patches and output are buffers from an Arena.
+        """
+        batch, height, width = images.shape
+        size = self.filter_size
+        new_height = height - size + 1
+        new_width = width - size + 1
+
+        # Column (i, j) of a patch row is pixel (i, j) of its region. Filling it
+        # for every region at once is one shifted copy of the whole batch.
+        grid = patches.reshape(batch, new_height, new_width, size * size)
+        for i in range(size):
+            for j in range(size):
+                np.copyto(grid[..., i * size + j], images[:, i : i + new_height, j : j + new_width])
+
+        np.matmul(
+            patches,
+            self.filters.reshape(self.num_filters, -1).T,
+            out=output.reshape(-1, self.num_filters),
+        )
+        output += self.biases
+        return output
+
+    def backward_batch(self, d_loss_d_output, patches, d_loss_d_filters, d_loss_d_biases):
+        """
+        Add up the filter and bias gradients for the whole batch.
+
+        The weights are not changed here; see apply_gradients. No gradient is
+        passed back to the image, since nothing comes before this layer.
+        """
+        d_output = d_loss_d_output.reshape(-1, self.num_filters)
+        np.matmul(d_output.T, patches, out=d_loss_d_filters.reshape(self.num_filters, -1))
+        np.sum(d_output, axis=0, out=d_loss_d_biases)
+
+    def apply_gradients(self, d_loss_d_filters, d_loss_d_biases, scale):
+        """Take one gradient descent step. scale is usually 1 / batch size."""
+        d_loss_d_filters *= self.learning_rate * scale
+        d_loss_d_biases *= self.learning_rate * scale
+        self.filters -= d_loss_d_filters
+        self.biases -= d_loss_d_biases
+
 
 class ReLU:
     """Keep positive signals and shut off negative signals."""
@@ -110,6 +182,17 @@ class ReLU:
         d_loss_d_input[self.last_input <= 0] = 0
         return d_loss_d_input
 
+    def forward_batch(self, input_data, output, mask):
+        """Batched forward pass; mask remembers which values got through."""
+        np.greater(input_data, 0.0, out=mask)
+        np.maximum(input_data, 0.0, out=output)
+        return output
+
+    def backward_batch(self, d_loss_d_output, mask, d_loss_d_input):
+        d_loss_d_input.fill(0.0)
+        np.copyto(d_loss_d_input, d_loss_d_output, where=mask)
+        return d_loss_d_input
+
 
 class MaxPool2D:
     """
@@ -171,6 +254,42 @@ class MaxPool2D:
 
         return d_loss_d_input
 
+    def window_corner(self, input_data, i, j):
+        """
+        Value (i, j) of every pooling window, for the whole batch.
+
+        A strided view, so nothing is copied: for i = j = 0 it is the top-left
+        value of each window, then the one to its right, and so on.
+        """
+        batch, height, width, num_filters = input_data.shape
+        new_height = height // self.pool_size
+        new_width = width // self.pool_size
+        return input_data[
+            :,
+            i : new_height * self.pool_size : self.pool_size,
+            j : new_width * self.pool_size : self.pool_size,
+        ]
+
+    def forward_batch(self, input_data, output):
+        """Batched forward pass: the maximum of the pool_size * pool_size corners."""
+        np.copyto(output, self.window_corner(input_data, 0, 0))
+        for i in range(self.pool_size):
+            for j in range(self.pool_size):
+                np.maximum(output, self.window_corner(input_data, i, j), out=output)
+        return output
+
+    def backward_batch(self, input_data, output, d_loss_d_output, d_loss_d_input, mask):
+        """
+        Batched backward pass. Like backward, every value that equals its
+        window's maximum receives the gradient. mask is scratch space.
+        """
+        d_loss_d_input.fill(0.0)
+        for i in range(self.pool_size):
+            for j in range(self.pool_size):
+                np.equal(self.window_corner(input_data, i, j), output, out=mask)
+                np.copyto(self.window_corner(d_loss_d_input, i, j), d_loss_d_output, where=mask)
+        return d_loss_d_input
+
 
 class Flatten:
     """Turn stacked feature maps into one long vector for the dense layer."""
@@ -183,6 +302,13 @@ class Flatten:
         # Backprop needs the original image-like shape again.
         return d_loss_d_output.reshape(self.last_shape)
 
+    def forward_batch(self, input_data):
+        # One row per image. The batch buffers are contiguous, so this is a view.
+        return input_data.reshape(len(input_data), -1)
+
+    def backward_batch(self, d_loss_d_output, shape):
+        return d_loss_d_output.reshape(shape)
+
 
 class Dense:
     """A fully connected layer: every input value connects to every output score."""
@@ -209,6 +335,26 @@ class Dense:
 
         return d_loss_d_input
 
+    def forward_batch(self, input_data, output):
+        """Scores for a batch of flattened inputs (batch, input_len)."""
+        np.matmul(input_data, self.weights, out=output)
+        output += self.biases
+        return output
+
+    def backward_batch(self, d_loss_d_output, input_data, d_loss_d_weights, d_loss_d_biases, d_loss_d_input):
+        """Add up the weight gradients for the batch and pass the gradient back."""
+        np.matmul(input_data.T, d_loss_d_output, out=d_loss_d_weights)
+        np.sum(d_loss_d_output, axis=0, out=d_loss_d_biases)
+        np.matmul(d_loss_d_output, self.weights.T, out=d_loss_d_input)
+        return d_loss_d_input
+
+    def apply_gradients(self, d_loss_d_weights, d_loss_d_biases, scale):
+        """Take one gradient descent step. scale is usually 1 / batch size."""
+        d_loss_d_weights *= self.learning_rate * scale
+        d_loss_d_biases *= self.learning_rate * scale
+        self.weights -= d_loss_d_weights
+        self.biases -= d_loss_d_biases
+
 
 class SoftmaxCrossEntropy:
     """
@@ -232,3 +378,34 @@ class SoftmaxCrossEntropy:
         gradient = self.probabilities.copy()
         gradient[self.label] -= 1
         return gradient
+
+    def forward_batch(self, logits, labels, probabilities, row, row_start, label_index, picked):
+        """
+        Batched forward pass. Returns the summed loss of the batch.
+
+        row and picked are scratch space with one value per image. row_start
+        holds where each image's row begins in probabilities, flattened
+        (0, num_classes, 2 * num_classes, ...). label_index gets where each
+        image's label is, which backward_batch needs.
+        """
+
+        np.max(logits, axis=1, keepdims=True, out=row)
+        np.subtract(logits, row, out=probabilities)
+        np.exp(probabilities, out=probabilities)
+        np.sum(probabilities, axis=1, keepdims=True, out=row)
+        probabilities /= row
+
+        np.add(row_start, labels, out=label_index)
+        np.take(probabilities, label_index, out=picked)
+
+        loss = row.reshape(-1)
+        np.add(picked, 1e-12, out=loss)
+        np.log(loss, out=loss)
+        return -float(np.sum(loss))
+
+    def backward_batch(self, probabilities, label_index, picked, d_loss_d_logits):
+        # Same as backward, for every image: prediction - target.
+        np.copyto(d_loss_d_logits, probabilities)
+        picked -= 1
+        np.put(d_loss_d_logits, label_index, picked)
+        return d_loss_d_logits
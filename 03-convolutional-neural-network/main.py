@@ -14,17 +14,17 @@ import numpy as np
 from cnn import TinyCNN
 
 
-def make_pattern(label, rng):
-    """Create one noisy 8x8 image for a chosen class."""
-    image = rng.normal(0.0, 0.08, (8, 8))
+def make_pattern(label, rng, size=8):
+    """Create one noisy size x size image (8x8 by default) for a chosen class."""
+    image = rng.normal(0.0, 0.08, (size, size))
 
     if label == 0:
         # Vertical line: one bright column.
-        col = rng.integers(2, 6)
+        col = rng.integers(2, size - 2)
         image[:, col] += 1.0
     elif label == 1:
         # Horizontal line: one bright row.
-        row = rng.integers(2, 6)
+        row = rng.integers(2, size - 2)
         image[row, :] += 1.0
     else:
         # Diagonal line: either left-to-right or right-to-left.
@@ -36,7 +36,7 @@ def make_pattern(label, rng):
     return np.clip(image, 0.0, 1.0)
 
 
-def make_dataset(samples_per_class=80, seed=7):
+def make_dataset(samples_per_class=80, seed=7, size=8):
     """Build a shuffled toy dataset for the CNN to learn from."""
     rng = np.random.default_rng(seed)
     images = []
@@ -44,7 +44,7 @@ def make_dataset(samples_per_class=80, seed=7):
 
     for label in range(3):
         for _ in range(samples_per_class):
-            images.append(make_pattern(label, rng))
+            images.append(make_pattern(label, rng, size))
             labels.append(label)
 
     images = np.array(images)
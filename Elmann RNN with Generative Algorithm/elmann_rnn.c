@@ -1,78 +1,308 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 // NETWORK CONFIGURATION
+// Every size can be overridden at compile time, e.g. gcc -DHIDDEN_LAYERS=2 rnn_ga.c
+#ifndef INPUT_NEURONS
 #define INPUT_NEURONS 6
+#endif
+#ifndef HIDDEN_NEURONS
 #define HIDDEN_NEURONS 8
+#endif
+#ifndef HIDDEN_LAYERS
+#define HIDDEN_LAYERS 1   // how many Elman layers are stacked, each with its own memory
+#endif
+#ifndef OUTPUT_NEURONS
 #define OUTPUT_NEURONS 6
-// #define TOTAL_WEIGHTS \
-//     (HIDDEN_NEURONS * (INPUT_NEURONS + 1) + \
-//      HIDDEN_NEURONS * HIDDEN_NEURONS + \
-//      OUTPUT_NEURONS * HIDDEN_NEURONS) // This is not a variable, it is a compile time number, compiler replaces it with an actual number
-#define TOTAL_WEIGHTS 168
-// Input (+1 for bias)
-double input[INPUT_NEURONS + 1];
-
-// Current hidden state (memory at this step)
+#endif
+
+/*
+ * LAYER SHAPES
+ *
+ * Every hidden layer looks at one vector, z = [x ; context]:
+ *   x       = what comes in from below, with a bias of 1.0 in front.
+ *             For the first layer that is the network input,
+ *             for every other layer it is the hidden state of the layer below.
+ *   context = this layer's own hidden state from the previous step.
+ *
+ * Because x and context sit side by side in memory, the input weights and the
+ * recurrent weights of one neuron sit side by side too, and the whole layer is
+ * a single matrix times a single vector. One pass over the weights per layer.
+ */
+/*
+ * SPARSE RECURRENT WEIGHTS (optional)
+ * Compile with -DRECURRENT_DEGREE=K, e.g. gcc -DHIDDEN_NEURONS=256 -DRECURRENT_DEGREE=16 rnn_ga.c
+ *
+ * Normally every hidden neuron reads the whole context, HIDDEN_NEURONS
+ * recurrent weights each, so a layer has HIDDEN_NEURONS^2 of them. With
+ * RECURRENT_DEGREE each neuron reads only K context neurons. Its row then
+ * holds K recurrent weights instead of HIDDEN_NEURONS, and connections[]
+ * says which context neuron each of them reads (the "ELL" sparse format:
+ * every row has the same number of entries, so no row lengths are stored).
+ * Genes get shorter and a step costs K instead of HIDDEN_NEURONS per neuron.
+ */
+#ifdef RECURRENT_DEGREE
+#if RECURRENT_DEGREE < 1 || RECURRENT_DEGREE >= HIDDEN_NEURONS
+#error "RECURRENT_DEGREE must be between 1 and HIDDEN_NEURONS - 1"
+#endif
+#define RECURRENT_WIDTH RECURRENT_DEGREE
+#else
+#define RECURRENT_WIDTH HIDDEN_NEURONS
+#endif
+
+#define LAYER_INPUTS(l)      ((l) == 0 ? INPUT_NEURONS + 1 : HIDDEN_NEURONS + 1)
+#define LAYER_STATE_WIDTH(l) (LAYER_INPUTS(l) + HIDDEN_NEURONS)   // length of z
+#define LAYER_WIDTH(l)       (LAYER_INPUTS(l) + RECURRENT_WIDTH)  // weights per neuron
+#define LAYER_WEIGHTS(l)     (HIDDEN_NEURONS * LAYER_WIDTH(l))
+
+// where layer l starts inside the flat weight array and inside the state array
+#define LAYER_WEIGHT_OFFSET(l) ((l) == 0 ? 0 : LAYER_WEIGHTS(0) + ((l) - 1) * LAYER_WEIGHTS(1))
+#define LAYER_STATE_OFFSET(l)  ((l) == 0 ? 0 : LAYER_STATE_WIDTH(0) + ((l) - 1) * LAYER_STATE_WIDTH(1))
+
+#define OUTPUT_WEIGHT_OFFSET LAYER_WEIGHT_OFFSET(HIDDEN_LAYERS)
+#define STATE_SIZE           LAYER_STATE_OFFSET(HIDDEN_LAYERS)
+
+// This is not a variable, it is a compile time number, compiler replaces it with an actual number.
+// With the default 1 layer of 8: 8 * (7 + 8) + 6 * 8 = 168
+#define TOTAL_WEIGHTS (OUTPUT_WEIGHT_OFFSET + OUTPUT_NEURONS * HIDDEN_NEURONS)
+
+// one column index per sparse recurrent weight, 0 for dense networks
+#ifdef RECURRENT_DEGREE
+#define TOTAL_CONNECTIONS (HIDDEN_LAYERS * HIDDEN_NEURONS * RECURRENT_DEGREE)
+#else
+#define TOTAL_CONNECTIONS 0
+#endif
+
+/*
+ * WEIGHT LAYOUT (this is also the gene layout the GA evolves)
+ *
+ * For each hidden layer l, bottom to top:
+ *   HIDDEN_NEURONS rows of LAYER_WIDTH(l) weights.
+ *   Row i is [input weights of neuron i ; recurrent weights of neuron i],
+ *   matching z = [x ; context].
+ *   (Sparse: the K recurrent weights of row i read the context neurons
+ *   listed in connections[], K entries per row in the same row order.)
+ * Then the output layer:
+ *   OUTPUT_NEURONS rows of HIDDEN_NEURONS weights, reading the top hidden layer.
+ *
+ * Nothing else is stored, so crossover and mutation can treat it as one flat list.
+ */
+double weights[TOTAL_WEIGHTS];
+
+#ifdef RECURRENT_DEGREE
+int connections[TOTAL_CONNECTIONS];
+#endif
+
+// All the z vectors, one per layer, back to back
+double state[STATE_SIZE];
+
+// Input (+1 for bias), the x part of the first layer
+double *const input = state;
+
+// Previous hidden state of the first layer (memory from last step)
+double *const context = state + INPUT_NEURONS + 1;
+
+// Current hidden state of the layer just computed (the top layer after a full step)
 double hidden[HIDDEN_NEURONS];
 
 // Output prediction
 double outputs[OUTPUT_NEURONS];
 
-// Previous hidden state (memory from last step)
-double context[HIDDEN_NEURONS];
-
-// Weights
-double w_input_hidden[HIDDEN_NEURONS][INPUT_NEURONS + 1];
-double w_hidden_hidden[HIDDEN_NEURONS][HIDDEN_NEURONS];
-double w_hidden_output[OUTPUT_NEURONS][HIDDEN_NEURONS];
-
 // ACTIVATION FUNCTION
 double sigmoid(double x){
     return 1.0 / (1.0 + exp(-x));
 }
 
-// RNN FEED FORWARD
-void RNN_feed_forward(void)
+/*
+ * LANE MATH
+ * The fast paths (evaluate_chromosome() in rnn_ga.c, rnn_kernels.c) apply
+ * tanh and sigmoid to many values at once. Calling libm's tanh() and exp()
+ * one value at a time would stop the compiler from doing them together, so
+ * these are written out as plain arithmetic the compiler can vectorize.
+ * They agree with libm to about 1e-15.
+ *
+ * lane_exp: split x = k * ln2 + r with |r| <= ln2 / 2, so e^x = 2^k * e^r.
+ * e^r comes from its Taylor series, 2^k is added straight into the exponent bits.
+ * Adding 1.5 * 2^52 rounds x / ln2 to an integer k and leaves k in the low bits.
+ */
+static inline double lane_exp(double x)
+{
+    const double shift = 0x1.8p52;
+    x = x < -708.0 ? -708.0 : (x > 708.0 ? 708.0 : x);
+
+    double t = x * 1.4426950408889634 + shift;
+    double k = t - shift;
+    double r = x - k * 6.93147180369123816490e-01 - k * 1.90821492927058770002e-10;
+
+    double p = 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    long long tb, pb;
+    memcpy(&tb, &t, sizeof(t));
+    memcpy(&pb, &p, sizeof(p));
+    pb += (long long)((unsigned long long)(tb - 0x4338000000000000ll) << 52);
+    memcpy(&p, &pb, sizeof(p));
+    return p;
+}
+
+static inline double lane_tanh(double x)
+{
+    return 1.0 - 2.0 / (lane_exp(2.0 * x) + 1.0);
+}
+
+static inline double lane_sigmoid(double x)
+{
+    return 1.0 / (1.0 + lane_exp(-x));
+}
+
+// FUSED LAYER KERNEL
+// out[i] = tanh(row i of w . z), input and recurrent contributions in one dot product
+void layer_forward(const double *w, const double *z, int rows, int width, double *out)
+{
+    for (int i = 0; i < rows; i++)
+    {
+        const double *row = w + i * width;
+        double sum = 0.0;
+
+        for (int j = 0; j < width; j++)
+            sum += row[j] * z[j];
+
+        out[i] = tanh(sum);
+    }
+}
+
+/*
+ * SPARSE LAYER KERNEL
+ * The same as layer_forward(), but each row reads the context through its
+ * degree column indices: dense over the inputs, then one multiply per
+ * connection instead of one per context neuron.
+ */
+void layer_forward_sparse(const double *w, const int *cols, const double *z,
+                          int rows, int inputs, int degree, double *out)
 {
-    int i, j;
+    const double *ctx = z + inputs;
 
-    // Update hidden state
-    for (i = 0; i < HIDDEN_NEURONS; i++)
+    for (int i = 0; i < rows; i++)
     {
+        const double *row = w + i * (inputs + degree);
+        const int *col = cols + i * degree;
         double sum = 0.0;
 
-        // Input contribution
-        for (j = 0; j < INPUT_NEURONS + 1; j++)
-            sum += w_input_hidden[i][j] * input[j];
+        for (int j = 0; j < inputs; j++)
+            sum += row[j] * z[j];
+        for (int k = 0; k < degree; k++)
+            sum += row[inputs + k] * ctx[col[k]];
+
+        out[i] = tanh(sum);
+    }
+}
+
+#include "rnn_kernels.c"
+
+// SPECIALIZED STEP
+// A single dense hidden layer whose size rnn_kernels.c has a kernel for runs
+// that kernel. RNN_init() picks it; call it from main, before any threads
+// start. Until then, and for every other network, RNN_step() runs its loops.
+#if HIDDEN_LAYERS == 1 && !defined(RECURRENT_DEGREE)
+const RnnShape rnn_step_shape = { INPUT_NEURONS, HIDDEN_NEURONS, OUTPUT_NEURONS };
+RnnKernel rnn_step_kernel;
+#endif
+
+void RNN_init(void)
+{
+#if HIDDEN_LAYERS == 1 && !defined(RECURRENT_DEGREE)
+    RnnKernel kernel = rnn_pick_kernel(&rnn_step_shape, NULL);
+    rnn_step_kernel = kernel == rnn_step_generic ? NULL : kernel;
+#endif
+}
+
+// RNN STEP
+// One time step for any set of weights (w) and any memory (z, laid out like state[]).
+// h receives the top hidden layer, out the predictions.
+// Keeping everything in arguments lets many independent sequences share one set of weights.
+void RNN_step(const double *w, double *z, double *h, double *out)
+{
+    int i, l;
+
+#if HIDDEN_LAYERS == 1 && !defined(RECURRENT_DEGREE)
+    if (rnn_step_kernel)
+    {
+        rnn_step_kernel(&rnn_step_shape, w, z, h, out);
+        return;
+    }
+#endif
+
+    // Update hidden state, layer by layer
+    for (l = 0; l < HIDDEN_LAYERS; l++)
+    {
+        double *zl = z + LAYER_STATE_OFFSET(l);
+
+#ifdef RECURRENT_DEGREE
+        // sparse networks read the loaded connections[]
+        layer_forward_sparse(w + LAYER_WEIGHT_OFFSET(l), connections + l * HIDDEN_NEURONS * RECURRENT_DEGREE,
+                             zl, HIDDEN_NEURONS, LAYER_INPUTS(l), RECURRENT_DEGREE, h);
+#else
+        layer_forward(w + LAYER_WEIGHT_OFFSET(l), zl, HIDDEN_NEURONS, LAYER_WIDTH(l), h);
+#endif
 
-        // Recurrent contribution
-        for (j = 0; j < HIDDEN_NEURONS; j++)
-            sum += w_hidden_hidden[i][j] * context[j];
+        // Update this layer's memory
+        memcpy(zl + LAYER_INPUTS(l), h, HIDDEN_NEURONS * sizeof(double));
 
-        hidden[i] = tanh(sum);
+        // The layer above reads this hidden state as its x (slot 0 is its bias)
+        if (l + 1 < HIDDEN_LAYERS)
+            memcpy(z + LAYER_STATE_OFFSET(l + 1) + 1, h, HIDDEN_NEURONS * sizeof(double));
     }
 
     // Compute output
+    const double *w_out = w + OUTPUT_WEIGHT_OFFSET;
     for (i = 0; i < OUTPUT_NEURONS; i++)
     {
         double sum = 0.0;
 
-        for (j = 0; j < HIDDEN_NEURONS; j++)
-            sum += w_hidden_output[i][j] * hidden[j];
+        for (int j = 0; j < HIDDEN_NEURONS; j++)
+            sum += w_out[i * HIDDEN_NEURONS + j] * h[j];
 
-        outputs[i] = sigmoid(sum);
+        out[i] = sigmoid(sum);
     }
+}
+
+// RNN FEED FORWARD
+void RNN_feed_forward(void)
+{
+    RNN_step(weights, state, hidden, outputs);
+}
+
+// resetting memory of any state array
+void reset_state(double *z)
+{
+    for (int l = 0; l < HIDDEN_LAYERS; l++)
+    {
+        double *zl = z + LAYER_STATE_OFFSET(l);
+
+        for (int i = 0; i < HIDDEN_NEURONS; i++)
+            zl[LAYER_INPUTS(l) + i] = 0.0;
 
-    // Update memory
-    for (i = 0; i < HIDDEN_NEURONS; i++)
-        context[i] = hidden[i];
+        // upper layers carry their own bias, the first layer gets it from input[0]
+        if (l > 0)
+            zl[0] = 1.0;
+    }
 }
 
 // resetting memory
 void reset_context()
 {
-    for (int i =0 ; i < HIDDEN_NEURONS; i++)
-        context[i] = 0.0;
-}
\ No newline at end of file
+    reset_state(state);
+}
@@ -0,0 +1,565 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * FILE OFFSETS
+ * A long run's history passes 2 GiB, more than a long holds on Windows and
+ * on 32-bit systems, so every offset is a 64-bit history_off. On 32-bit Unix
+ * off_t only has 64 bits when _FILE_OFFSET_BITS is 64 before the first
+ * system header, which is why rnn_ga.c and visualizer.c define it first.
+ */
+#ifdef _WIN32
+typedef long long history_off;
+#define history_seek _fseeki64
+#define history_tell _ftelli64
+#else
+#include <sys/types.h>
+typedef off_t history_off;
+#define history_seek fseeko
+#define history_tell ftello
+#endif
+_Static_assert(sizeof(history_off) == 8, "define _FILE_OFFSET_BITS 64 before the first #include");
+
+/*
+ * EVOLUTION HISTORY FILE
+ *
+ * Included by rnn_ga.c (--history FILE), rnn_history.c and visualizer.c.
+ * One record per generation: its fitness numbers and the gene of its best
+ * chromosome, so any generation's best network can be looked at later
+ * without running evolution again.
+ *
+ *   header     the network's sizes, so a reader knows how long a gene is
+ *   records    one per generation, only ever appended
+ *   index      where each block starts, written when the run ends
+ *   footer     where the index starts
+ *
+ * A gene is stored as the difference from the previous generation's best:
+ * the two are XORed 8 bytes at a time. Weights the two share (children copy
+ * most weights from their parents) give 0, a weight that moved a little
+ * gives a number whose top bytes are 0 (same sign, same exponent). Runs of
+ * zero words are stored as a count and every other word without its
+ * leading zero bytes, see history_encode().
+ *
+ * Every HISTORY_KEYFRAME generations the gene is stored whole instead (the
+ * difference from all zeros). A keyframe and the records after it form a
+ * block. Reading generation g means finding its block in the index, then
+ * reading that one block up to g: at most HISTORY_KEYFRAME records, however
+ * long the run was.
+ *
+ * The index holds one entry per block with a summary of its fitness, enough
+ * to draw the fitness curve of a million generations without reading them.
+ * If a run is killed before it writes the index, history_open() rebuilds it
+ * by walking the records, and stops at the first one that was cut short.
+ */
+
+#ifndef HISTORY_KEYFRAME
+#define HISTORY_KEYFRAME 64 // a whole gene every this many generations
+#endif
+
+#define HISTORY_MAGIC   0x31545349484e4e52ull // "RNNHIST1"
+#define HISTORY_VERSION 1
+#define RECORD_MAGIC    0x44524352u           // "RCRD"
+#define INDEX_MAGIC     0x58444e49u           // "INDX"
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t inputs, hidden, layers, outputs;
+    uint32_t weights;      // doubles per gene, TOTAL_WEIGHTS of the run
+    uint32_t connections;  // ints per gene, TOTAL_CONNECTIONS of the run (sparse networks)
+    uint32_t keyframe;
+    uint32_t reserved[2];
+} HistoryHeader;
+
+typedef struct {
+    double best;      // fitness of the chromosome whose gene is stored
+    double mean;
+    double worst;
+    double seconds;   // since the run started
+} HistoryStats;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t gen;
+    uint32_t bytes;     // size of the encoded gene after this
+    uint32_t keyframe;  // 1 = difference from zeros, 0 = from the previous record
+    HistoryStats stats;
+} HistoryRecord;
+
+typedef struct {
+    uint64_t offset;    // of the block's keyframe
+    uint32_t first_gen;
+    uint32_t gens;
+    float best_max;     // highest best fitness in the block
+    float best_min;
+    float best_last;    // stats of its last generation
+    float mean_last;
+} HistoryBlock;
+
+typedef struct {
+    uint64_t index_offset;
+    uint32_t blocks;
+    uint32_t magic;
+} HistoryFooter;
+
+// words in a gene: the weights, then the connections two ints per word
+static int history_words(const HistoryHeader *head)
+{
+    return head->weights + (head->connections + 1) / 2;
+}
+
+// largest encoding of n words: a count pair and 9 bytes per word
+static size_t history_max_bytes(int n)
+{
+    return (size_t)n * 11 + 32;
+}
+
+static void pack_gene(const HistoryHeader *head, const double *gene, const int *cols, uint64_t *words)
+{
+    words[history_words(head) - 1] = 0;
+    memcpy(words, gene, head->weights * sizeof(double));
+    if (head->connections)
+        memcpy(words + head->weights, cols, head->connections * sizeof(int));
+}
+
+static void unpack_gene(const HistoryHeader *head, const uint64_t *words, double *gene, int *cols)
+{
+    if (gene)
+        memcpy(gene, words, head->weights * sizeof(double));
+    if (cols && head->connections)
+        memcpy(cols, words + head->weights, head->connections * sizeof(int));
+}
+
+static uint8_t *put_varint(uint8_t *out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *out++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *out++ = (uint8_t)v;
+    return out;
+}
+
+// 0 if the input ends in the middle of the number
+static int get_varint(const uint8_t **in, const uint8_t *end, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; *in < end && shift < 64; shift += 7)
+    {
+        uint8_t b = *(*in)++;
+        *v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * history_encode
+ * Store now[] as its difference from prev[], n words each. The output is
+ * pairs of (zero words, changed words) counts, each followed by its changed
+ * words: one byte saying how many of the word's top bytes are zero, then
+ * the rest of its bytes, lowest first. Returns the bytes written.
+ */
+size_t history_encode(const uint64_t *now, const uint64_t *prev, int n, uint8_t *out)
+{
+    uint8_t *o = out;
+
+    for (int i = 0; i < n;)
+    {
+        int zeros = 0, changed = 0;
+        while (i + zeros < n && now[i + zeros] == prev[i + zeros])
+            zeros++;
+        while (i + zeros + changed < n && now[i + zeros + changed] != prev[i + zeros + changed])
+            changed++;
+
+        o = put_varint(o, zeros);
+        o = put_varint(o, changed);
+        for (int k = i + zeros; k < i + zeros + changed; k++)
+        {
+            uint64_t x = now[k] ^ prev[k];
+            int top_zero = __builtin_clzll(x) / 8;
+            *o++ = (uint8_t)top_zero;
+            for (int b = 0; b < 8 - top_zero; b++)
+                *o++ = (uint8_t)(x >> (8 * b));
+        }
+        i += zeros + changed;
+    }
+    return o - out;
+}
+
+/*
+ * history_decode
+ * Turn words[] (the previous gene, or zeros for a keyframe) into the gene
+ * encoded in in[]. Returns 0 if in[] is damaged.
+ */
+int history_decode(const uint8_t *in, size_t bytes, uint64_t *words, int n)
+{
+    const uint8_t *end = in + bytes;
+    int i = 0;
+
+    while (in < end)
+    {
+        uint64_t zeros, changed;
+        if (!get_varint(&in, end, &zeros) || !get_varint(&in, end, &changed) ||
+            zeros > (uint64_t)(n - i) || changed > (uint64_t)(n - i) - zeros)
+            return 0;
+        i += (int)zeros;
+
+        for (uint64_t k = 0; k < changed; k++, i++)
+        {
+            if (in >= end || *in > 7 || end - in < 9 - *in)
+                return 0;
+            int len = 8 - *in++;
+            uint64_t x = 0;
+            for (int b = 0; b < len; b++)
+                x |= (uint64_t)*in++ << (8 * b);
+            words[i] ^= x;
+        }
+    }
+    return i == n;
+}
+
+/*
+ * WRITING
+ *   HistoryWriter w;
+ *   history_create(&w, "run.hist", &head);   sizes in head, the rest is filled in
+ *   history_append(&w, &stats, gene, cols);  once per generation, cols NULL for dense networks
+ *   history_finish(&w);                      writes the index and closes
+ */
+typedef struct {
+    FILE *f;
+    HistoryHeader head;
+    uint64_t *prev, *now;   // last gene written and the one being written
+    uint64_t *zero;         // what a keyframe is encoded against
+    uint8_t *buf;
+    HistoryBlock *blocks;
+    int block_count, block_cap;
+    uint32_t gens;
+} HistoryWriter;
+
+int history_create(HistoryWriter *w, const char *path, const HistoryHeader *shape)
+{
+    memset(w, 0, sizeof(*w));
+    w->head = *shape;
+    w->head.magic = HISTORY_MAGIC;
+    w->head.version = HISTORY_VERSION;
+    w->head.keyframe = HISTORY_KEYFRAME;
+
+    int n = history_words(&w->head);
+    w->prev = calloc(n, sizeof(uint64_t));
+    w->now = calloc(n, sizeof(uint64_t));
+    w->zero = calloc(n, sizeof(uint64_t));
+    w->buf = malloc(history_max_bytes(n));
+    w->f = fopen(path, "wb");
+    if (!w->f || !w->prev || !w->now || !w->zero || !w->buf ||
+        fwrite(&w->head, sizeof(w->head), 1, w->f) != 1)
+    {
+        perror(path);
+        if (w->f) fclose(w->f);
+        w->f = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+int history_append(HistoryWriter *w, const HistoryStats *stats, const double *gene, const int *cols)
+{
+    if (!w->f)
+        return 0;
+
+    int n = history_words(&w->head);
+    int keyframe = w->gens % w->head.keyframe == 0;
+
+    if (keyframe && w->block_count == w->block_cap)
+    {
+        int cap = w->block_cap ? 2 * w->block_cap : 256;
+        HistoryBlock *bigger = realloc(w->blocks, cap * sizeof(HistoryBlock));
+        if (!bigger)
+            return 0;
+        w->blocks = bigger;
+        w->block_cap = cap;
+    }
+
+    pack_gene(&w->head, gene, cols, w->now);
+    HistoryRecord rec = { RECORD_MAGIC, w->gens, 0, keyframe, *stats };
+    rec.bytes = (uint32_t)history_encode(w->now, keyframe ? w->zero : w->prev, n, w->buf);
+
+    // nothing below changes until the record is on disk; a failed write is
+    // rewound so the next record goes where this one should have
+    history_off offset = history_tell(w->f);
+    if (fwrite(&rec, sizeof(rec), 1, w->f) != 1 || fwrite(w->buf, 1, rec.bytes, w->f) != rec.bytes)
+    {
+        history_seek(w->f, offset, SEEK_SET);
+        return 0;
+    }
+
+    if (keyframe)
+        w->blocks[w->block_count++] = (HistoryBlock){ .offset = (uint64_t)offset, .first_gen = w->gens,
+                                                      .best_max = (float)stats->best,
+                                                      .best_min = (float)stats->best };
+    HistoryBlock *block = &w->blocks[w->block_count - 1];
+
+    uint64_t *t = w->prev;
+    w->prev = w->now;
+    w->now = t;
+
+    block->gens++;
+    block->best_max = fmaxf(block->best_max, (float)stats->best);
+    block->best_min = fminf(block->best_min, (float)stats->best);
+    block->best_last = (float)stats->best;
+    block->mean_last = (float)stats->mean;
+    w->gens++;
+
+    // a finished block is on disk even if the run is killed later
+    if (w->gens % w->head.keyframe == 0)
+        fflush(w->f);
+    return 1;
+}
+
+void history_finish(HistoryWriter *w)
+{
+    if (w->f)
+    {
+        HistoryFooter foot = { (uint64_t)history_tell(w->f), w->block_count, INDEX_MAGIC };
+        fwrite(w->blocks, sizeof(HistoryBlock), w->block_count, w->f);
+        fwrite(&foot, sizeof(foot), 1, w->f);
+        fclose(w->f);
+    }
+    free(w->prev);
+    free(w->now);
+    free(w->zero);
+    free(w->buf);
+    free(w->blocks);
+    memset(w, 0, sizeof(*w));
+}
+
+/*
+ * READING
+ *   History h;
+ *   history_open(&h, "run.hist");
+ *   history_read(&h, gen, &stats, gene, cols);   any generation, in any order
+ *   history_close(&h);
+ * Reading the generation after the last one read continues from there
+ * instead of going back to the keyframe, so stepping through is cheap.
+ */
+typedef struct {
+    FILE *f;
+    HistoryHeader head;
+    HistoryBlock *blocks;
+    int block_count;
+    int gens;
+    int recovered;          // the index was missing and was rebuilt
+
+    uint64_t *words;        // gene of generation at_gen
+    HistoryStats at_stats;
+    uint8_t *buf;
+    size_t buf_cap;
+    int at_gen;             // -1: nothing decoded yet
+    history_off next_offset; // record after at_gen
+} History;
+
+static int read_record(History *h, HistoryRecord *rec)
+{
+    if (fread(rec, sizeof(*rec), 1, h->f) != 1 || rec->magic != RECORD_MAGIC)
+        return 0;
+    if (rec->bytes > h->buf_cap)
+    {
+        uint8_t *bigger = realloc(h->buf, rec->bytes);
+        if (!bigger)
+            return 0;
+        h->buf = bigger;
+        h->buf_cap = rec->bytes;
+    }
+    return fread(h->buf, 1, rec->bytes, h->f) == rec->bytes;
+}
+
+// the record's header only: seek past its gene
+static int skip_record(History *h, HistoryRecord *rec)
+{
+    return fread(rec, sizeof(*rec), 1, h->f) == 1 && rec->magic == RECORD_MAGIC &&
+           history_seek(h->f, (history_off)rec->bytes, SEEK_CUR) == 0;
+}
+
+static int read_index(History *h)
+{
+    HistoryFooter foot;
+
+    if (history_seek(h->f, -(history_off)sizeof(foot), SEEK_END) != 0 ||
+        fread(&foot, sizeof(foot), 1, h->f) != 1 || foot.magic != INDEX_MAGIC ||
+        history_seek(h->f, (history_off)foot.index_offset, SEEK_SET) != 0)
+        return 0;
+
+    h->blocks = malloc((foot.blocks ? foot.blocks : 1) * sizeof(HistoryBlock));
+    if (!h->blocks || fread(h->blocks, sizeof(HistoryBlock), foot.blocks, h->f) != foot.blocks)
+        return 0;
+    h->block_count = foot.blocks;
+    return 1;
+}
+
+// no index: walk the records and build one, up to the first damaged record
+static void rebuild_index(History *h)
+{
+    HistoryRecord rec;
+    int cap = 0;
+    history_off offset = sizeof(HistoryHeader);
+
+    free(h->blocks);
+    h->blocks = NULL;
+    h->block_count = 0;
+    h->recovered = 1;
+    history_seek(h->f, offset, SEEK_SET);
+
+    for (uint32_t gen = 0; read_record(h, &rec) && rec.gen == gen; gen++)
+    {
+        if (rec.keyframe != (gen % h->head.keyframe == 0))
+            break;
+        if (rec.keyframe)
+        {
+            if (h->block_count == cap)
+            {
+                HistoryBlock *bigger = realloc(h->blocks, (cap ? 2 * cap : 256) * sizeof(HistoryBlock));
+                if (!bigger)
+                    break; // keep the blocks found so far
+                h->blocks = bigger;
+                cap = cap ? 2 * cap : 256;
+            }
+            h->blocks[h->block_count++] = (HistoryBlock){ .offset = (uint64_t)offset, .first_gen = gen,
+                                                          .best_max = (float)rec.stats.best,
+                                                          .best_min = (float)rec.stats.best };
+        }
+        HistoryBlock *b = &h->blocks[h->block_count - 1];
+        b->gens++;
+        b->best_max = fmaxf(b->best_max, (float)rec.stats.best);
+        b->best_min = fminf(b->best_min, (float)rec.stats.best);
+        b->best_last = (float)rec.stats.best;
+        b->mean_last = (float)rec.stats.mean;
+        offset += sizeof(rec) + rec.bytes;
+    }
+}
+
+// 0 if path is not a history file
+int history_open(History *h, const char *path)
+{
+    memset(h, 0, sizeof(*h));
+    h->at_gen = -1;
+    h->f = fopen(path, "rb");
+    if (!h->f)
+    {
+        perror(path);
+        return 0;
+    }
+    if (fread(&h->head, sizeof(h->head), 1, h->f) != 1 || h->head.magic != HISTORY_MAGIC ||
+        h->head.version != HISTORY_VERSION || h->head.keyframe == 0)
+    {
+        fprintf(stderr, "%s: not a history file\n", path);
+        fclose(h->f);
+        h->f = NULL;
+        return 0;
+    }
+
+    if (!read_index(h))
+        rebuild_index(h);
+    if (h->block_count > 0)
+    {
+        HistoryBlock *last = &h->blocks[h->block_count - 1];
+        h->gens = last->first_gen + last->gens;
+    }
+    h->words = calloc(history_words(&h->head), sizeof(uint64_t));
+    return h->words != NULL;
+}
+
+/*
+ * history_read
+ * Stats and gene (and connections, for sparse runs) of the best chromosome
+ * of generation gen. gene and cols may be NULL. Returns 0 if gen is not in
+ * the file or its block is damaged.
+ */
+int history_read(History *h, int gen, HistoryStats *stats, double *gene, int *cols)
+{
+    if (gen < 0 || gen >= h->gens)
+        return 0;
+
+    int n = history_words(&h->head);
+    int block = gen / h->head.keyframe;
+    HistoryRecord rec;
+
+    // start again from the keyframe unless gen comes later in the block already being read
+    if (!(h->at_gen >= 0 && h->at_gen <= gen && h->at_gen / (int)h->head.keyframe == block))
+    {
+        h->at_gen = (int)h->blocks[block].first_gen - 1;
+        h->next_offset = (history_off)h->blocks[block].offset;
+        memset(h->words, 0, n * sizeof(uint64_t));
+    }
+
+    if (h->at_gen < gen && history_seek(h->f, h->next_offset, SEEK_SET) != 0)
+        return 0;
+
+    while (h->at_gen < gen)
+    {
+        if (!read_record(h, &rec) || rec.gen != (uint32_t)h->at_gen + 1 ||
+            !history_decode(h->buf, rec.bytes, h->words, n))
+        {
+            h->at_gen = -1;
+            return 0;
+        }
+        h->at_gen++;
+        h->next_offset += sizeof(rec) + rec.bytes;
+        h->at_stats = rec.stats;
+    }
+
+    if (stats)
+        *stats = h->at_stats;
+    unpack_gene(&h->head, h->words, gene, cols);
+    return 1;
+}
+
+/*
+ * history_curve
+ * The best fitness over the whole run as at most n points, point k being
+ * the highest in its share of the generations. Long runs are drawn from the
+ * index alone; when there are fewer blocks than points the records' stats
+ * are read (genes skipped), which stays below n * HISTORY_KEYFRAME records.
+ * Returns the number of points.
+ */
+int history_curve(History *h, float *best, int n)
+{
+    int points = h->gens < n ? h->gens : n;
+
+    for (int k = 0; k < points; k++)
+        best[k] = 0.0f;
+
+    if (h->block_count >= points)
+    {
+        for (int b = 0; b < h->block_count; b++)
+        {
+            int k = (int)((long long)h->blocks[b].first_gen * points / h->gens);
+            best[k] = fmaxf(best[k], h->blocks[b].best_max);
+        }
+        return points;
+    }
+
+    HistoryRecord rec;
+    history_seek(h->f, (history_off)sizeof(HistoryHeader), SEEK_SET);
+    h->at_gen = -1; // the file position moves, so history_read() starts from a keyframe
+    for (int gen = 0; gen < h->gens && skip_record(h, &rec); gen++)
+    {
+        int k = (int)((long long)gen * points / h->gens);
+        best[k] = fmaxf(best[k], (float)rec.stats.best);
+    }
+    return points;
+}
+
+void history_close(History *h)
+{
+    if (h->f)
+        fclose(h->f);
+    free(h->blocks);
+    free(h->words);
+    free(h->buf);
+    memset(h, 0, sizeof(*h));
+}
@@ -0,0 +1,341 @@
+#include <pthread.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/*
+ * POPULATION ARENA
+ *
+ * Included by rnn_ga.c. All chromosomes live in one block of memory:
+ *
+ *   genes         the weights of chromosome i start at genes + i * TOTAL_WEIGHTS
+ *   new_genes     the next generation, same shape. reproduce() fills it,
+ *                 then the two pointers swap, nothing is copied
+ *   fitness       one number per chromosome, packed together
+ *   task_fitness  MAX_TASKS numbers per chromosome
+ *   connections   sparse networks only (RECURRENT_DEGREE in elmann_rnn.c):
+ *   new_connections  which context neuron each recurrent weight reads,
+ *                 TOTAL_CONNECTIONS per chromosome, swapped with the genes
+ *
+ * Use GENE(i), population.fitness[i], TASK_FITNESS(i) and CONNECTIONS(i)
+ * to reach them.
+ * The size is picked at run time (rnn_ga --pop N), not compiled in.
+ *
+ * Why fitness is kept apart: tournament selection compares fitness values
+ * of random chromosomes. Packed together, thousands of them fit in a few
+ * cache lines. Stored after each gene, every comparison would pull in a
+ * different 1.3 KB chromosome just to read 8 bytes of it.
+ *
+ * Why huge pages: scoring walks through every weight of every chromosome.
+ * With normal 4 KB pages a population of 100,000 covers about 65,000 pages,
+ * far more than the CPU can keep address translations for (the TLB), so it
+ * keeps stopping to look them up. With 2 MB pages it is about 130.
+ *
+ * Why threads are pinned: on a machine with several sockets each socket has
+ * its own memory (a NUMA node) and reaching the other socket's memory is
+ * slower. The population is cut into one slice per thread, always the same
+ * slice for the same thread, and each thread only runs on the CPUs of one
+ * node. The first thing every thread does is write zeros over its slice.
+ * Linux puts a page on the node of the CPU that first writes it, so each
+ * slice ends up in the memory closest to the thread that scores it.
+ */
+
+#define MAX_THREADS 256
+#define MAX_NODES   64
+#define HUGE_PAGE   ((size_t)2 << 20)
+#define CACHE_LINE  64
+
+typedef struct {
+    int size;              // number of chromosomes
+    double *genes;
+    double *new_genes;
+    double *fitness;
+    double *task_fitness;
+    int *connections;
+    int *new_connections;
+
+    void *block;           // the one allocation they all live in
+    size_t block_bytes;
+    const char *pages;     // how the block is backed, for the report
+
+    int threads;           // one slice of the population per thread
+    int nodes;             // NUMA nodes threads are pinned to, 0 = no pinning
+#ifdef __linux__
+    cpu_set_t node_cpus[MAX_NODES];
+#endif
+} Population;
+
+Population population;
+
+#define GENE(i)         (population.genes + (size_t)(i) * TOTAL_WEIGHTS)
+#define NEW_GENE(i)     (population.new_genes + (size_t)(i) * TOTAL_WEIGHTS)
+#define TASK_FITNESS(i) (population.task_fitness + (size_t)(i) * MAX_TASKS)
+#define CONNECTIONS(i)     (population.connections + (size_t)(i) * TOTAL_CONNECTIONS)
+#define NEW_CONNECTIONS(i) (population.new_connections + (size_t)(i) * TOTAL_CONNECTIONS)
+
+// first chromosome of thread t's slice; the slice ends where thread t + 1's begins
+#define SLICE_START(t) ((int)((long long)population.size * (t) / population.threads))
+
+static size_t round_up(size_t n, size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+#ifdef __linux__
+/* "0-3,8-11" -> CPUs 0 1 2 3 8 9 10 11 */
+static void parse_cpulist(const char *s, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    while (*s >= '0' && *s <= '9')
+    {
+        char *end;
+        long first = strtol(s, &end, 10), last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long c = first; c <= last && c < CPU_SETSIZE; c++)
+            CPU_SET(c, set);
+        s = (*end == ',') ? end + 1 : end;
+    }
+}
+#endif
+
+/*
+ * find_numa_nodes
+ * Read which CPUs belong to which node from /sys/devices/system/node,
+ * keeping only the CPUs this process is allowed to run on. With a single
+ * node there is nothing to gain, so threads are left unpinned.
+ */
+static void find_numa_nodes()
+{
+    population.nodes = 0;
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+
+    for (int n = 0; n < 1024 && population.nodes < MAX_NODES; n++)
+    {
+        char path[64], line[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+
+        FILE *f = fopen(path, "r");
+        if (!f)
+            continue; // node numbers can have gaps
+        int ok = fgets(line, sizeof(line), f) != NULL;
+        fclose(f);
+        if (!ok)
+            continue;
+
+        cpu_set_t *cpus = &population.node_cpus[population.nodes];
+        parse_cpulist(line, cpus);
+        CPU_AND(cpus, cpus, &allowed);
+        if (CPU_COUNT(cpus) > 0)
+            population.nodes++;
+    }
+
+    if (population.nodes < 2)
+        population.nodes = 0;
+#endif
+}
+
+// CPUs this process may use, the default thread count
+int available_cpus()
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        return CPU_COUNT(&allowed);
+#endif
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return (int)n;
+#endif
+    return 1;
+}
+
+/*
+ * map_block
+ * Ask for explicit huge pages first (these have to be reserved by the
+ * admin, e.g. via /proc/sys/vm/nr_hugepages). Otherwise take normal pages
+ * starting on a 2 MB boundary and ask the kernel to back them with huge
+ * pages when it can (transparent huge pages).
+ */
+static void *map_block(size_t bytes)
+{
+#ifdef _WIN32
+    population.pages = "normal";
+    return malloc(bytes);
+#else
+#ifdef MAP_HUGETLB
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+    {
+        population.pages = "huge (hugetlbfs)";
+        return p;
+    }
+#endif
+
+    // one spare huge page so the start can be moved up to a 2 MB boundary
+    size_t padded = bytes + HUGE_PAGE;
+    char *raw = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+
+    char *start = (char *)round_up((uintptr_t)raw, HUGE_PAGE);
+    if (start > raw)
+        munmap(raw, start - raw);
+    if (raw + padded > start + bytes)
+        munmap(start + bytes, raw + padded - (start + bytes));
+
+    population.pages = "normal";
+#ifdef MADV_HUGEPAGE
+    if (madvise(start, bytes, MADV_HUGEPAGE) == 0)
+        population.pages = "transparent huge";
+#endif
+    return start;
+#endif
+}
+
+/*
+ * for_each_slice
+ * Run work(start, end, arg) once per thread, each on its own slice,
+ * and wait for all of them. Thread t always gets slice t and, with several
+ * NUMA nodes, always runs on node t * nodes / threads.
+ */
+typedef void (*SliceWork)(int start, int end, void *arg);
+
+typedef struct {
+    int thread;
+    SliceWork work;
+    void *arg;
+} SliceJob;
+
+static void *slice_thread(void *p)
+{
+    SliceJob *job = p;
+
+#ifdef __linux__
+    if (population.nodes > 0)
+    {
+        int node = job->thread * population.nodes / population.threads;
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &population.node_cpus[node]);
+    }
+#endif
+
+    job->work(SLICE_START(job->thread), SLICE_START(job->thread + 1), job->arg);
+    return NULL;
+}
+
+void for_each_slice(SliceWork work, void *arg)
+{
+    if (population.threads == 1)
+    {
+        work(0, population.size, arg);
+        return;
+    }
+
+    pthread_t id[MAX_THREADS];
+    SliceJob jobs[MAX_THREADS];
+    int started[MAX_THREADS];
+
+    for (int t = 0; t < population.threads; t++)
+    {
+        jobs[t] = (SliceJob){t, work, arg};
+        started[t] = pthread_create(&id[t], NULL, slice_thread, &jobs[t]) == 0;
+        if (!started[t]) // out of threads: do the slice here instead
+            work(SLICE_START(t), SLICE_START(t + 1), arg);
+    }
+    for (int t = 0; t < population.threads; t++)
+        if (started[t])
+            pthread_join(id[t], NULL);
+}
+
+// first touch: every thread writes its own slice of each array
+static void touch_slice(int start, int end, void *arg)
+{
+    (void)arg;
+    size_t n = (size_t)(end - start);
+
+    memset(GENE(start), 0, n * TOTAL_WEIGHTS * sizeof(double));
+    memset(NEW_GENE(start), 0, n * TOTAL_WEIGHTS * sizeof(double));
+    memset(population.fitness + start, 0, n * sizeof(double));
+    memset(TASK_FITNESS(start), 0, n * MAX_TASKS * sizeof(double));
+    memset(CONNECTIONS(start), 0, n * TOTAL_CONNECTIONS * sizeof(int));
+    memset(NEW_CONNECTIONS(start), 0, n * TOTAL_CONNECTIONS * sizeof(int));
+}
+
+/*
+ * alloc_population
+ * Set up the arena for size chromosomes scored by threads threads
+ * (0 = one per available CPU). Call once, before anything else touches
+ * the population. Returns 0 if the memory is not there.
+ */
+int alloc_population(int size, int threads)
+{
+    if (threads <= 0)
+        threads = available_cpus();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads > size)
+        threads = size;
+    if (threads < 1)
+        threads = 1;
+
+    size_t gene_bytes = round_up((size_t)size * TOTAL_WEIGHTS * sizeof(double), CACHE_LINE);
+    size_t fitness_bytes = round_up((size_t)size * sizeof(double), CACHE_LINE);
+    size_t task_bytes = round_up((size_t)size * MAX_TASKS * sizeof(double), CACHE_LINE);
+    size_t connection_bytes = round_up((size_t)size * TOTAL_CONNECTIONS * sizeof(int), CACHE_LINE);
+    size_t bytes = round_up(2 * gene_bytes + fitness_bytes + task_bytes + 2 * connection_bytes, HUGE_PAGE);
+
+    char *block = map_block(bytes);
+    if (!block)
+    {
+        fprintf(stderr, "could not allocate %zu MB for a population of %d\n", bytes >> 20, size);
+        return 0;
+    }
+
+    population.size = size;
+    population.threads = threads;
+    population.block = block;
+    population.block_bytes = bytes;
+    population.genes = (double *)block;
+    population.new_genes = (double *)(block + gene_bytes);
+    population.fitness = (double *)(block + 2 * gene_bytes);
+    population.task_fitness = (double *)(block + 2 * gene_bytes + fitness_bytes);
+    population.connections = (int *)(block + 2 * gene_bytes + fitness_bytes + task_bytes);
+    population.new_connections = population.connections + connection_bytes / sizeof(int);
+
+    find_numa_nodes();
+    for_each_slice(touch_slice, NULL);
+    return 1;
+}
+
+// the next generation becomes the current one
+void swap_generations()
+{
+    double *g = population.genes;
+    population.genes = population.new_genes;
+    population.new_genes = g;
+
+    int *c = population.connections;
+    population.connections = population.new_connections;
+    population.new_connections = c;
+}
+
+void print_population_info()
+{
+    printf("Population %d: %zu MB, %s pages, %d thread%s",
+           population.size, population.block_bytes >> 20, population.pages,
+           population.threads, population.threads == 1 ? "" : "s");
+    if (population.nodes > 0)
+        printf(" on %d NUMA nodes", population.nodes);
+    printf("\n");
+}
@@ -0,0 +1,283 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * PROFILING (rnn_ga --profile)
+ *
+ * Included by rnn_ga.c after population.c. A timer says how long scoring
+ * takes, not why. The CPU's own counters tell more:
+ *
+ *   cycles, instructions   instructions per cycle (IPC). Near 4 the CPU is
+ *                          doing all it can, well below 1 it is mostly waiting
+ *   L1d misses             reads that were not in the nearest cache
+ *   LLC misses             reads that had to go all the way to memory
+ *   branch misses          ifs the CPU guessed wrong and had to redo
+ *
+ * Linux hands these out through perf_event_open(). Every thread opens its
+ * own set when it starts its slice and reads them when it is done, so each
+ * phase (scoring, breeding) gets numbers per thread. They are divided by
+ * the work done: per time step of one network on one task for scoring, per
+ * child for breeding. Misses per step that stay flat as the population grows
+ * mean the genes stream through the caches as they should.
+ *
+ * Containers and many virtual machines have no counters, and
+ * kernel.perf_event_paranoid above 2 forbids them. Then only the timers
+ * run: wall time and CPU time per thread (CLOCK_THREAD_CPUTIME_ID).
+ */
+
+enum { PHASE_EVALUATE, PHASE_REPRODUCE, PHASE_COUNT };
+enum { CTR_CYCLES, CTR_INSTRUCTIONS, CTR_L1D_MISSES, CTR_LLC_MISSES, CTR_BRANCH_MISSES, CTR_COUNT };
+
+const char *phase_names[PHASE_COUNT] = { "evaluate", "reproduce" };
+const char *phase_units[PHASE_COUNT] = { "steps", "children" };
+const char *counter_names[CTR_COUNT] = { "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses" };
+
+typedef struct {
+    double wall, cpu;          // seconds
+    double count[CTR_COUNT];   // corrected for time shared with other counters
+    long long items;           // steps or children
+    long long calls;
+} ProfileSlot;
+
+typedef struct {
+    int enabled;
+    int have[CTR_COUNT];       // counters this machine gives us
+    int counters;              // how many of them
+    const char *why;           // why there are none
+    double phase_wall[PHASE_COUNT];
+    ProfileSlot slot[PHASE_COUNT][MAX_THREADS];   // one per phase and thread
+} Profile;
+
+Profile profile;
+
+static double clock_seconds(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#ifdef __linux__
+// counter c for the calling thread, user space only, stopped; -1 if not there
+static int open_counter(int c)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (c)
+    {
+    case CTR_CYCLES:        attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case CTR_INSTRUCTIONS:  attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case CTR_LLC_MISSES:    attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+    case CTR_BRANCH_MISSES: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    case CTR_L1D_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    }
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * When there are more counters than the CPU has slots for, the kernel takes
+ * turns and each counter only runs part of the time. Scale it up to what it
+ * would have counted running all along.
+ */
+static double read_counter(int fd)
+{
+    uint64_t v[3]; // value, time enabled, time running
+    if (read(fd, v, sizeof(v)) != (ssize_t)sizeof(v) || v[2] == 0)
+        return 0.0;
+    return (double)v[0] * ((double)v[1] / (double)v[2]);
+}
+#endif
+
+/*
+ * profile_init
+ * Turn profiling on and find out which counters this machine has, by
+ * opening each one once.
+ */
+void profile_init()
+{
+    profile.enabled = 1;
+    profile.why = "not Linux";
+#ifdef __linux__
+    for (int c = 0; c < CTR_COUNT; c++)
+    {
+        int fd = open_counter(c);
+        if (fd >= 0)
+        {
+            profile.have[c] = 1;
+            profile.counters++;
+            close(fd);
+        }
+        else if (c == CTR_CYCLES)
+            profile.why = strerror(errno);
+    }
+#endif
+}
+
+typedef struct {
+    int phase;
+    long long items_per_chromosome;
+    SliceWork work;
+    void *arg;
+} ProfiledWork;
+
+// which thread got the slice that starts at start (slices are never empty)
+static int slice_thread_index(int start)
+{
+    for (int t = 0; t < population.threads; t++)
+        if (SLICE_START(t) == start)
+            return t;
+    return 0;
+}
+
+static void profiled_slice(int start, int end, void *p)
+{
+    ProfiledWork *pw = p;
+    ProfileSlot *s = &profile.slot[pw->phase][slice_thread_index(start)];
+    int fd[CTR_COUNT];
+
+    for (int c = 0; c < CTR_COUNT; c++)
+    {
+        fd[c] = -1;
+#ifdef __linux__
+        if (profile.have[c] && (fd[c] = open_counter(c)) >= 0)
+            ioctl(fd[c], PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+    double wall = clock_seconds(CLOCK_MONOTONIC);
+    double cpu = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+
+    pw->work(start, end, pw->arg);
+
+    s->cpu += clock_seconds(CLOCK_THREAD_CPUTIME_ID) - cpu;
+    s->wall += clock_seconds(CLOCK_MONOTONIC) - wall;
+    for (int c = 0; c < CTR_COUNT; c++)
+    {
+#ifdef __linux__
+        if (fd[c] >= 0)
+        {
+            ioctl(fd[c], PERF_EVENT_IOC_DISABLE, 0);
+            s->count[c] += read_counter(fd[c]);
+            close(fd[c]);
+        }
+#endif
+    }
+    s->items += (long long)(end - start) * pw->items_per_chromosome;
+    s->calls++;
+}
+
+/*
+ * profile_slices
+ * for_each_slice(work, arg), measured as part of phase when profiling is
+ * on. items_per_chromosome is the work one chromosome stands for: time
+ * steps when scoring, 1 when breeding.
+ */
+void profile_slices(int phase, SliceWork work, void *arg, long long items_per_chromosome)
+{
+    if (!profile.enabled)
+    {
+        for_each_slice(work, arg);
+        return;
+    }
+
+    ProfiledWork pw = { phase, items_per_chromosome, work, arg };
+    double wall = clock_seconds(CLOCK_MONOTONIC);
+    for_each_slice(profiled_slice, &pw);
+    profile.phase_wall[phase] += clock_seconds(CLOCK_MONOTONIC) - wall;
+}
+
+static void print_slot(const char *phase, const char *thread, const ProfileSlot *s)
+{
+    double per = s->items > 0 ? 1.0 / s->items : 0.0;
+
+    printf("%-10s %-6s %9.3f %9.3f %9.1f", phase, thread, s->wall, s->cpu, s->cpu * 1e9 * per);
+    if (profile.counters)
+    {
+        if (profile.have[CTR_CYCLES] && profile.have[CTR_INSTRUCTIONS] && s->count[CTR_CYCLES] > 0)
+            printf(" %6.2f", s->count[CTR_INSTRUCTIONS] / s->count[CTR_CYCLES]);
+        else
+            printf(" %6s", "-");
+        for (int c = CTR_L1D_MISSES; c < CTR_COUNT; c++)
+            if (profile.have[c])
+                printf(" %14.4f", s->count[c] * per);
+            else
+                printf(" %14s", "-");
+    }
+    printf("\n");
+}
+
+/*
+ * print_profile
+ * One line per phase and thread, and a total per phase. ns/item is CPU
+ * time per step or child; the miss columns are per step or child too.
+ */
+void print_profile()
+{
+    if (!profile.enabled)
+        return;
+
+    printf("\nProfile, %d thread%s: ", population.threads, population.threads == 1 ? "" : "s");
+    if (profile.counters)
+    {
+        printf("counters");
+        for (int c = 0; c < CTR_COUNT; c++)
+            if (profile.have[c])
+                printf(" %s", counter_names[c]);
+        printf("\n");
+    }
+    else
+        printf("no hardware counters (%s), timers only\n", profile.why);
+
+    printf("%-10s %-6s %9s %9s %9s", "phase", "thread", "wall s", "cpu s", "ns/item");
+    if (profile.counters)
+        printf(" %6s %14s %14s %14s", "IPC", "L1d miss/item", "LLC miss/item", "br miss/item");
+    printf("\n");
+
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        ProfileSlot total = { 0 };
+        char name[32];
+
+        for (int t = 0; t < population.threads; t++)
+        {
+            ProfileSlot *s = &profile.slot[p][t];
+            if (s->calls == 0)
+                continue;
+            if (population.threads > 1)
+            {
+                snprintf(name, sizeof(name), "%d", t);
+                print_slot(phase_names[p], name, s);
+            }
+            total.cpu += s->cpu;
+            total.items += s->items;
+            total.calls += s->calls;
+            for (int c = 0; c < CTR_COUNT; c++)
+                total.count[c] += s->count[c];
+        }
+        if (total.calls == 0)
+            continue;
+
+        total.wall = profile.phase_wall[p];
+        print_slot(phase_names[p], "all", &total);
+        printf("%-10s %lld %s\n", "", total.items, phase_units[p]);
+    }
+}
@@ -0,0 +1,61 @@
+#include <stdint.h>
+#include <math.h>
+
+/*
+ * RANDOM STREAMS
+ *
+ * rand() is one long sequence shared by the whole program: to get the
+ * 1000th number back you have to draw the 999 before it again.
+ *
+ * A stream here is addressed by numbers instead, e.g. (seed, generation,
+ * child). Asking for the same address always gives the same numbers, in any
+ * order, from any thread or process. That lets us throw random numbers away
+ * and regenerate them later instead of storing them.
+ *
+ * The generator is splitmix64: add a constant, then scramble the bits.
+ */
+typedef struct {
+    uint64_t state;
+} Rng;
+
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// the stream at address (seed, a, b)
+static inline Rng rng_stream(uint64_t seed, uint64_t a, uint64_t b)
+{
+    Rng r = { mix64(mix64(mix64(seed) ^ a) ^ b) };
+    return r;
+}
+
+static inline uint64_t rng_next(Rng *r)
+{
+    r->state += 0x9e3779b97f4a7c15ull;
+    return mix64(r->state);
+}
+
+// uniform in [0, 1), 53 random bits
+static inline double rng_uniform(Rng *r)
+{
+    return (rng_next(r) >> 11) * 0x1.0p-53;
+}
+
+// n draws from a normal distribution (mean 0, spread 1), Box-Muller in pairs
+void rng_gaussians(Rng *r, double *out, int n)
+{
+    for (int j = 0; j < n; j += 2)
+    {
+        double u1 = 1.0 - rng_uniform(r); // (0, 1], keeps log() finite
+        double u2 = rng_uniform(r);
+        double radius = sqrt(-2.0 * log(u1));
+
+        out[j] = radius * cos(2.0 * M_PI * u2);
+        if (j + 1 < n)
+            out[j + 1] = radius * sin(2.0 * M_PI * u2);
+    }
+}
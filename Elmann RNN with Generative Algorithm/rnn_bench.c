@@ -0,0 +1,181 @@
+#include <time.h>
+#include "elmann_rnn.c"
+#include "rng.c"
+
+/*
+ * KERNEL BENCHMARK
+ *
+ * Times every specialized kernel in rnn_kernels.c against the generic step
+ * for the same shape, and checks they agree.
+ *
+ * The timed baseline is generic_lane_step(): rnn_step_generic()'s loops with
+ * the kernels' own lane_tanh and lane_sigmoid, so the speedup is what the
+ * fixed sizes buy and not a faster tanh. The agreement check is against
+ * rnn_step_generic() itself, with libm's tanh.
+ *
+ *   gcc -O3 rnn_bench.c -lm -o rnn_bench
+ *   ./rnn_bench [steps]
+ *
+ * Build without -march: the AVX2 kernels carry their own target and are
+ * only run when the CPU has AVX2 and FMA, so one binary shows both columns.
+ * The networks get random weights in [-1, 1], like the GA's first generation.
+ */
+
+#define BENCH_STEPS 200000 // default steps timed per run
+#define BENCH_REPEATS 5
+#define CHECK_STEPS 100     // steps compared against the generic step
+#define MAX_BENCH_HIDDEN 64
+#define MAX_BENCH_WIDTH  (64 + 1 + MAX_BENCH_HIDDEN)
+
+double seconds_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// rnn_step_generic() with the lane math the kernels use
+void generic_lane_step(const RnnShape *s, const double *w, double *z, double *h, double *out)
+{
+    int width = s->inputs + 1 + s->hidden;
+    const double *w_out = w + s->hidden * width;
+
+    for (int i = 0; i < s->hidden; i++)
+    {
+        const double *row = w + i * width;
+        double sum = 0.0;
+
+        for (int j = 0; j < width; j++)
+            sum += row[j] * z[j];
+
+        h[i] = lane_tanh(sum);
+    }
+    memcpy(z + s->inputs + 1, h, s->hidden * sizeof(double));
+
+    for (int i = 0; i < s->outputs; i++)
+    {
+        double sum = 0.0;
+
+        for (int j = 0; j < s->hidden; j++)
+            sum += w_out[i * s->hidden + j] * h[j];
+
+        out[i] = lane_sigmoid(sum);
+    }
+}
+
+// a fresh z for shape: bias, a one-hot input, empty memory
+void bench_reset(const RnnShape *s, double *z)
+{
+    memset(z, 0, (s->inputs + 1 + s->hidden) * sizeof(double));
+    z[0] = 1.0;
+    z[1] = 1.0;
+}
+
+// step the network, feeding each prediction back as the next input
+void bench_feed(const RnnShape *s, double *z, const double *out)
+{
+    int best = 0;
+    for (int k = 1; k < s->outputs; k++)
+        if (out[k] > out[best]) best = k;
+
+    for (int k = 0; k < s->inputs; k++)
+        z[1 + k] = 0.0;
+    z[1 + best % s->inputs] = 1.0;
+}
+
+// largest difference between the two kernels' outputs over CHECK_STEPS steps
+double bench_check(const RnnShape *s, const double *w, RnnKernel kernel)
+{
+    double z1[MAX_BENCH_WIDTH], z2[MAX_BENCH_WIDTH];
+    double h1[MAX_BENCH_HIDDEN], h2[MAX_BENCH_HIDDEN];
+    double o1[MAX_BENCH_HIDDEN], o2[MAX_BENCH_HIDDEN];
+    double worst = 0.0;
+
+    bench_reset(s, z1);
+    bench_reset(s, z2);
+    for (int t = 0; t < CHECK_STEPS; t++)
+    {
+        rnn_step_generic(s, w, z1, h1, o1);
+        kernel(s, w, z2, h2, o2);
+
+        for (int k = 0; k < s->outputs; k++)
+            worst = fmax(worst, fabs(o1[k] - o2[k]));
+        for (int k = 0; k < s->hidden; k++)
+            worst = fmax(worst, fabs(h1[k] - h2[k]));
+
+        // restart both from the generic state, so this measures one step's error
+        // and not how a chaotic network magnifies it over many steps
+        bench_feed(s, z1, o1);
+        memcpy(z2, z1, (s->inputs + 1 + s->hidden) * sizeof(double));
+    }
+    return worst;
+}
+
+// nanoseconds per step, the best of BENCH_REPEATS runs (the others were interrupted more)
+double bench_time(const RnnShape *s, const double *w, RnnKernel kernel, long steps)
+{
+    double z[MAX_BENCH_WIDTH], h[MAX_BENCH_HIDDEN], out[MAX_BENCH_HIDDEN];
+    double sink = 0.0, best = 1e30;
+
+    for (int rep = 0; rep < BENCH_REPEATS; rep++)
+    {
+        bench_reset(s, z);
+        double start = seconds_now();
+        for (long t = 0; t < steps; t++)
+        {
+            kernel(s, w, z, h, out);
+            sink += out[0];
+        }
+        best = fmin(best, seconds_now() - start);
+    }
+
+    if (sink == 42.0) // keeps the loop from being thrown away
+        printf(" ");
+    return best / steps * 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    long steps = argc > 1 ? atol(argv[1]) : BENCH_STEPS;
+    if (steps <= 0)
+    {
+        fprintf(stderr, "usage: %s [steps]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-12s %-6s %12s %12s %9s %10s\n", "shape", "isa", "generic ns", "kernel ns", "speedup", "max diff");
+
+    for (int k = 0; k < RNN_KERNEL_COUNT; k++)
+    {
+        const RnnKernelEntry *e = &rnn_kernels[k];
+        const RnnShape *s = &e->shape;
+        int width = s->inputs + 1 + s->hidden;
+        int total = s->hidden * width + s->outputs * s->hidden;
+        double w[total];
+
+        if (s->hidden > MAX_BENCH_HIDDEN || s->outputs > MAX_BENCH_HIDDEN || width > MAX_BENCH_WIDTH)
+            continue;
+
+        char name[40];
+        snprintf(name, sizeof(name), "%d-%d-%d", s->inputs, s->hidden, s->outputs);
+
+        if (!rnn_cpu_has(e->isa))
+        {
+            printf("%-12s %-6s %12s\n", name, e->isa, "(not supported by this CPU)");
+            continue;
+        }
+
+        Rng r = rng_stream(1, k, 0);
+        for (int j = 0; j < total; j++)
+            w[j] = rng_uniform(&r) * 2.0 - 1.0;
+
+        double diff = bench_check(s, w, e->kernel);
+        double generic_ns = bench_time(s, w, generic_lane_step, steps);
+        double kernel_ns = bench_time(s, w, e->kernel, steps);
+
+        printf("%-12s %-6s %12.1f %12.1f %8.2fx %10.1e\n",
+               name, e->isa, generic_ns, kernel_ns, generic_ns / kernel_ns, diff);
+    }
+
+    return 0;
+}
@@ -0,0 +1,619 @@
+#define RNN_GA_NO_MAIN
+#include "rnn_ga.c"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*
+ * DISTRIBUTED GA: ONE COORDINATOR, MANY WORKERS
+ *
+ * The GA from rnn_ga.c, with scoring spread over several processes that talk
+ * over sockets. Works on one machine (Unix sockets) or several (TCP).
+ *
+ *   ./rnn_dist --workers 4                  coordinator + 4 local worker processes
+ *   ./rnn_dist --listen 5000 --workers 4    coordinator, waits for 4 TCP workers
+ *   ./rnn_dist --connect host:5000          a worker, on any machine
+ *
+ * Every worker keeps its own full copy of the population, and no weights are
+ * ever sent. Each generation:
+ *   1. The coordinator hands every worker a shard (a range of chromosomes).
+ *      Workers score their shard and send back only the fitness values.
+ *   2. The coordinator runs selection and sends the plan for the next
+ *      generation: for each child, its two parents and a random seed.
+ *   3. Every worker (and the coordinator) builds the children itself with
+ *      make_child(), which gives the same child everywhere for the same seed.
+ * That is 16 bytes per child instead of 8 bytes per weight.
+ *
+ * If a worker dies or stops answering, its shard goes to the workers that
+ * are left. They already have the whole population, so nothing else needs to
+ * move. If every worker is gone the coordinator scores the rest itself.
+ *
+ * Generation 0 comes from the seed too, so the run is the same no matter how
+ * many workers take part or which of them die along the way.
+ *
+ * --pop and --generations work as in rnn_ga. Only the coordinator needs
+ * them: MSG_INIT tells every worker the population size.
+ *
+ * A worker that starts an answer and then stalls halfway counts as failed
+ * too: the rest of a message must follow within --timeout seconds.
+ *
+ * Testing worker failure on one machine:
+ *   ./rnn_dist --workers 4 --kill-worker-at 10
+ *   ./rnn_dist --workers 4 --stall-worker-at 10 --timeout 2
+ */
+
+#define MAX_WORKERS 64
+
+enum { MSG_INIT, MSG_PLAN, MSG_EVAL, MSG_FITNESS, MSG_DONE };
+
+// every message starts with this, followed by its payload
+typedef struct {
+    uint32_t type;
+    uint32_t gen;
+    uint32_t start;  // MSG_EVAL / MSG_FITNESS: first chromosome of the shard
+    uint32_t count;  // MSG_EVAL / MSG_FITNESS: shard size, MSG_PLAN: children, MSG_INIT: population size
+} MsgHeader;
+
+// MSG_PLAN payload, one per child
+typedef struct {
+    uint32_t parent1;
+    uint32_t parent2;
+    uint64_t seed;
+} PlanEntry;
+
+typedef struct {
+    int fd;
+    int alive;
+    int busy;          // waiting for this worker's fitness values
+    int start, count;  // the shard it is working on
+    double deadline;   // CLOCK_MONOTONIC seconds by which the answer must be in
+    pid_t pid;         // local workers only
+} Worker;
+
+Worker workers[MAX_WORKERS];
+int worker_count = 0;
+
+uint64_t run_seed;
+int kill_worker_at = -1;   // test hook: worker 0 exits when asked to score this generation
+int stall_worker_at = -1;  // test hook: worker 0 sends half an answer for this generation, then hangs
+int reply_timeout = 30;    // seconds before a silent worker counts as dead
+size_t bytes_sent = 0, bytes_received = 0;
+
+/* Socket helpers: keep going until everything is sent or read */
+int write_all(int fd, const void *buf, size_t n)
+{
+    const char *p = buf;
+    while (n > 0)
+    {
+        ssize_t w = send(fd, p, n, 0);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return 0;
+        p += w; n -= w; bytes_sent += w;
+    }
+    return 1;
+}
+
+int read_all(int fd, void *buf, size_t n)
+{
+    char *p = buf;
+    while (n > 0)
+    {
+        ssize_t r = recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        p += r; n -= r; bytes_received += r;
+    }
+    return 1;
+}
+
+/*
+ * read_until
+ * read_all() for the coordinator, which must never wait on one worker for
+ * ever: the bytes have to arrive before deadline (CLOCK_MONOTONIC seconds).
+ * Returns 1 when all n bytes are in, 0 if the connection closed and -1 if
+ * time ran out, e.g. after half a message.
+ */
+int read_until(int fd, void *buf, size_t n, double deadline)
+{
+    char *p = buf;
+    while (n > 0)
+    {
+        double left = deadline - clock_seconds(CLOCK_MONOTONIC);
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = left > 0.0 ? poll(&pfd, 1, (int)(left * 1000.0) + 1) : 0;
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) return 0;
+        if (ready == 0) return -1;
+
+        ssize_t r = recv(fd, p, n, MSG_DONTWAIT);
+        if (r < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+        if (r <= 0) return 0;
+        p += r; n -= r; bytes_received += r;
+    }
+    return 1;
+}
+
+int send_msg(int fd, uint32_t type, uint32_t gen, uint32_t start, uint32_t count,
+             const void *payload, size_t size)
+{
+    MsgHeader h = {type, gen, start, count};
+    return write_all(fd, &h, sizeof(h)) && (size == 0 || write_all(fd, payload, size));
+}
+
+/*
+ * Both sides build the population the same way, from the seed alone
+ * (init_population() in rnn_ga.c), then apply the same plans to it.
+ */
+void apply_plan(const PlanEntry *plan)
+{
+    for (int i = 0; i < population.size; i++)
+    {
+        Rng r = rng_stream(plan[i].seed, 0, 0);
+        make_child(plan[i].parent1, plan[i].parent2, &r, i);
+        population.fitness[i] = 0.0;
+    }
+    swap_generations();
+}
+
+/*
+ * WORKER
+ * Wait for messages and do what they say until the coordinator is done
+ * or goes away.
+ */
+int worker_loop(int fd, int index)
+{
+    PlanEntry *plan = NULL;
+    double *fitness = NULL;
+    MsgHeader h;
+
+    while (read_all(fd, &h, sizeof(h)))
+    {
+        if (h.type == MSG_INIT)
+        {
+            uint64_t seed;
+            if (!read_all(fd, &seed, sizeof(seed)) || h.count < 2) break;
+            // local workers were forked with the population already there
+            if ((int)h.count != population.size && !alloc_population(h.count, 1)) break;
+            free(plan);
+            free(fitness);
+            plan = malloc(h.count * sizeof(PlanEntry));
+            fitness = malloc(h.count * sizeof(double));
+            if (!plan || !fitness) break;
+            init_population(seed);
+        }
+        else if (!plan)
+            break; // anything before MSG_INIT
+        else if (h.type == MSG_PLAN)
+        {
+            if ((int)h.count != population.size || !read_all(fd, plan, h.count * sizeof(PlanEntry))) break;
+            apply_plan(plan);
+        }
+        else if (h.type == MSG_EVAL)
+        {
+            if (h.start + h.count > (uint32_t)population.size) break;
+            if (index == 0 && (int)h.gen == kill_worker_at)
+            {
+                fprintf(stderr, "worker 0: exiting at generation %d (--kill-worker-at)\n", kill_worker_at);
+                _exit(1);
+            }
+
+            for (uint32_t i = 0; i < h.count; i++)
+                fitness[i] = evaluate_chromosome(GENE(h.start + i), CONNECTIONS(h.start + i),
+                                                 TASK_FITNESS(h.start + i));
+
+            if (index == 0 && (int)h.gen == stall_worker_at)
+            {
+                MsgHeader reply = {MSG_FITNESS, h.gen, h.start, h.count};
+                fprintf(stderr, "worker 0: stalling mid-message at generation %d (--stall-worker-at)\n",
+                        stall_worker_at);
+                write_all(fd, &reply, sizeof(reply));
+                for (;;)
+                    pause();
+            }
+
+            if (!send_msg(fd, MSG_FITNESS, h.gen, h.start, h.count, fitness, h.count * sizeof(double)))
+                break;
+        }
+        else
+            break; // MSG_DONE or anything unexpected
+    }
+
+    free(plan);
+    free(fitness);
+    close(fd);
+    return 0;
+}
+
+/*
+ * COORDINATOR
+ */
+void worker_lost(Worker *w, const char *why)
+{
+    fprintf(stderr, "worker %d lost (%s), reassigning its shard\n", (int)(w - workers), why);
+    if (w->pid > 0)
+        kill(w->pid, SIGKILL); // a hung local worker would otherwise keep the waitpid() at the end waiting
+    close(w->fd);
+    w->alive = 0;
+    w->busy = 0;
+}
+
+int live_workers()
+{
+    int n = 0;
+    for (int k = 0; k < worker_count; k++)
+        n += workers[k].alive;
+    return n;
+}
+
+void broadcast(uint32_t type, uint32_t gen, uint32_t count, const void *payload, size_t size)
+{
+    for (int k = 0; k < worker_count; k++)
+        if (workers[k].alive && !send_msg(workers[k].fd, type, gen, 0, count, payload, size))
+            worker_lost(&workers[k], "send failed");
+}
+
+/*
+ * dist_evaluate
+ * Fill in population.fitness[] for generation gen.
+ *
+ * The population is cut into one shard per live worker. Shards of workers
+ * that fail go back into the queue and are handed to the next idle worker.
+ */
+void dist_evaluate(int gen)
+{
+    int size = population.size;
+    int *queue_start = malloc((2 * MAX_WORKERS + size) * sizeof(int));
+    int *queue_count = malloc((2 * MAX_WORKERS + size) * sizeof(int));
+    double *fitness = malloc(size * sizeof(double));
+    int queued = 0, remaining = size;
+    int n = live_workers();
+
+    if (!queue_start || !queue_count || !fitness)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (int k = 0, start = 0; k < n; k++)
+    {
+        int count = size / n + (k < size % n);
+        if (count == 0) continue;
+        queue_start[queued] = start;
+        queue_count[queued++] = count;
+        start += count;
+    }
+    if (n == 0)
+    {
+        queue_start[0] = 0;
+        queue_count[queued++] = size;
+    }
+
+    while (remaining > 0)
+    {
+        // hand queued shards to idle workers
+        for (int k = 0; k < worker_count && queued > 0; k++)
+        {
+            Worker *w = &workers[k];
+            if (!w->alive || w->busy) continue;
+
+            w->start = queue_start[--queued];
+            w->count = queue_count[queued];
+            w->busy = 1;
+            w->deadline = clock_seconds(CLOCK_MONOTONIC) + reply_timeout;
+            if (!send_msg(w->fd, MSG_EVAL, gen, w->start, w->count, NULL, 0))
+            {
+                worker_lost(w, "send failed");
+                queue_start[queued] = w->start;
+                queue_count[queued++] = w->count;
+            }
+        }
+
+        // nobody left: score the rest here
+        if (live_workers() == 0)
+        {
+            while (queued > 0)
+            {
+                queued--;
+                for (int i = queue_start[queued]; i < queue_start[queued] + queue_count[queued]; i++)
+                    population.fitness[i] = evaluate_chromosome(GENE(i), CONNECTIONS(i), TASK_FITNESS(i));
+                remaining -= queue_count[queued];
+            }
+            break;
+        }
+
+        // wait for answers, until the earliest deadline of a busy worker
+        struct pollfd fds[MAX_WORKERS];
+        int who[MAX_WORKERS], nfds = 0;
+        double now = clock_seconds(CLOCK_MONOTONIC), first_deadline = now + reply_timeout;
+        for (int k = 0; k < worker_count; k++)
+            if (workers[k].alive && workers[k].busy)
+            {
+                fds[nfds].fd = workers[k].fd;
+                fds[nfds].events = POLLIN;
+                who[nfds++] = k;
+                first_deadline = fmin(first_deadline, workers[k].deadline);
+            }
+
+        int wait_ms = first_deadline > now ? (int)((first_deadline - now) * 1000.0) + 1 : 0;
+        int ready = poll(fds, nfds, wait_ms);
+        if (ready < 0 && errno == EINTR) continue;
+        now = clock_seconds(CLOCK_MONOTONIC);
+
+        for (int f = 0; f < nfds; f++)
+        {
+            Worker *w = &workers[who[f]];
+            MsgHeader h;
+            double deadline = clock_seconds(CLOCK_MONOTONIC) + reply_timeout;
+            int got = 1;
+
+            if (ready <= 0 || !(fds[f].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                // only a worker past its own deadline is dropped, not every slower one
+                if (now < w->deadline)
+                    continue;
+                worker_lost(w, "timed out");
+            }
+            else if ((got = read_until(w->fd, &h, sizeof(h), deadline)) != 1)
+                worker_lost(w, got < 0 ? "stalled in the middle of a message" : "connection closed");
+            else if (h.type != MSG_FITNESS || h.gen != (uint32_t)gen ||
+                     (int)h.start != w->start || (int)h.count != w->count)
+                worker_lost(w, "unexpected message");
+            else if ((got = read_until(w->fd, fitness, h.count * sizeof(double), deadline)) != 1)
+                worker_lost(w, got < 0 ? "stalled in the middle of a message" : "connection closed");
+            else
+            {
+                for (uint32_t i = 0; i < h.count; i++)
+                    population.fitness[h.start + i] = fitness[i];
+                remaining -= h.count;
+                w->busy = 0;
+                continue;
+            }
+
+            queue_start[queued] = w->start;
+            queue_count[queued++] = w->count;
+        }
+    }
+
+    free(queue_start);
+    free(queue_count);
+    free(fitness);
+}
+
+/*
+ * dist_plan
+ * Tournament selection like select_parent(), drawing from the stream
+ * (seed, generation) so the coordinator's choices are reproducible too.
+ */
+void dist_plan(int gen, PlanEntry *plan)
+{
+    Rng r = rng_stream(run_seed, gen, ~0ull);
+
+    for (int i = 0; i < population.size; i++)
+    {
+        for (int p = 0; p < 2; p++)
+        {
+            int a = rng_next(&r) % population.size;
+            int b = rng_next(&r) % population.size;
+            uint32_t parent = (population.fitness[a] > population.fitness[b]) ? a : b;
+            if (p == 0) plan[i].parent1 = parent;
+            else plan[i].parent2 = parent;
+        }
+        plan[i].seed = rng_next(&r);
+    }
+}
+
+/* Start local workers, each on one end of a Unix socket pair */
+int spawn_local_workers(int n)
+{
+    for (int k = 0; k < n; k++)
+    {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        {
+            perror("socketpair");
+            return 0;
+        }
+
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            return 0;
+        }
+        if (pid == 0)
+        {
+            close(sv[0]);
+            for (int j = 0; j < worker_count; j++)
+                close(workers[j].fd);
+            exit(worker_loop(sv[1], k));
+        }
+
+        close(sv[1]);
+        workers[worker_count++] = (Worker){ .fd = sv[0], .alive = 1, .pid = pid };
+    }
+    return 1;
+}
+
+/* Wait for n workers to connect over TCP */
+int accept_tcp_workers(int port, int n)
+{
+    int ls = socket(AF_INET6, SOCK_STREAM, 0);
+    int on = 1, off = 0;
+    struct sockaddr_in6 addr = { .sin6_family = AF_INET6, .sin6_port = htons(port), .sin6_addr = in6addr_any };
+
+    setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(ls, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    if (ls < 0 || bind(ls, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(ls, n) < 0)
+    {
+        perror("listen");
+        return 0;
+    }
+
+    printf("Waiting for %d workers on port %d\n", n, port);
+    while (worker_count < n)
+    {
+        int fd = accept(ls, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR) continue;
+            perror("accept");
+            return 0;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        workers[worker_count++] = (Worker){ .fd = fd, .alive = 1, .pid = -1 };
+        printf("  worker %d connected\n", worker_count - 1);
+    }
+    close(ls);
+    return 1;
+}
+
+/* Worker side of TCP: connect to host:port, then serve */
+int connect_tcp(const char *target)
+{
+    char host[256];
+    const char *colon = strrchr(target, ':');
+    if (!colon || colon - target >= (int)sizeof(host))
+    {
+        fprintf(stderr, "expected host:port, got %s\n", target);
+        return -1;
+    }
+    memcpy(host, target, colon - target);
+    host[colon - target] = 0;
+
+    struct addrinfo hints = { .ai_socktype = SOCK_STREAM }, *res, *ai;
+    int err = getaddrinfo(host, colon + 1, &hints, &res);
+    if (err)
+    {
+        fprintf(stderr, "%s: %s\n", target, gai_strerror(err));
+        return -1;
+    }
+
+    int fd = -1;
+    for (ai = res; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0)
+        fprintf(stderr, "could not connect to %s\n", target);
+    else
+    {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    int n_workers = 4, port = -1, pop_size = POP_SIZE;
+    const char *connect_to = NULL;
+
+    run_seed = time(NULL);
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--workers") == 0 && a + 1 < argc) n_workers = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--listen") == 0 && a + 1 < argc) port = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--connect") == 0 && a + 1 < argc) connect_to = argv[++a];
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) run_seed = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--pop") == 0 && a + 1 < argc) pop_size = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--generations") == 0 && a + 1 < argc) generations = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--timeout") == 0 && a + 1 < argc) reply_timeout = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--kill-worker-at") == 0 && a + 1 < argc) kill_worker_at = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--stall-worker-at") == 0 && a + 1 < argc) stall_worker_at = atoi(argv[++a]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--workers N] [--listen PORT | --connect HOST:PORT]\n"
+                            "          [--pop N] [--generations N] [--seed S] [--timeout SEC]\n"
+                            "          [--kill-worker-at GEN] [--stall-worker-at GEN]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN); // a dead worker shows up as a failed send, not a crash
+    RNN_init();
+    build_task_suite();
+
+    // a TCP worker sizes its population when MSG_INIT arrives
+    if (connect_to)
+    {
+        int fd = connect_tcp(connect_to);
+        return fd < 0 ? 1 : worker_loop(fd, -1);
+    }
+
+    if (pop_size < 2) pop_size = 2;
+    if (generations < 0) generations = 0;
+
+    // the processes are the parallelism here, so each scores on one thread
+    if (!alloc_population(pop_size, 1))
+        return 1;
+
+    if (n_workers < 0 || n_workers > MAX_WORKERS)
+    {
+        fprintf(stderr, "--workers must be between 0 and %d\n", MAX_WORKERS);
+        return 1;
+    }
+    if (port >= 0 ? !accept_tcp_workers(port, n_workers) : !spawn_local_workers(n_workers))
+        return 1;
+
+    printf("Seed %llu, %d workers\n", (unsigned long long)run_seed, worker_count);
+
+    init_population(run_seed);
+    broadcast(MSG_INIT, 0, pop_size, &run_seed, sizeof(run_seed));
+
+    PlanEntry *plan = malloc(pop_size * sizeof(PlanEntry));
+    if (!plan)
+        return 1;
+    for (int gen = 0; gen < generations; gen++)
+    {
+        size_t before = bytes_sent + bytes_received;
+
+        dist_evaluate(gen);
+        dist_plan(gen, plan);
+        broadcast(MSG_PLAN, gen, pop_size, plan, pop_size * sizeof(PlanEntry));
+        apply_plan(plan);
+
+        printf("Generation %d complete (%d workers, %zu bytes on the wire)\n",
+               gen, live_workers(), bytes_sent + bytes_received - before);
+    }
+
+    // Score the final population, then find the best individual in it
+    dist_evaluate(generations);
+    broadcast(MSG_DONE, generations, 0, NULL, 0);
+    free(plan);
+
+    int best = 0;
+    for (int i = 1; i < pop_size; i++)
+        if (population.fitness[i] > population.fitness[best])
+            best = i;
+
+    double task_fit[MAX_TASKS];
+    evaluate_chromosome(GENE(best), CONNECTIONS(best), task_fit);
+
+    printf("\nBest fitness: %f\n", population.fitness[best]);
+    printf("\nPer task:\n");
+    for (int t = 0; t < task_count; t++)
+        printf("  %-14s weight %.2f  fitness %f\n", tasks[t].name, tasks[t].weight, task_fit[t]);
+
+    for (int k = 0; k < worker_count; k++)
+    {
+        if (workers[k].alive) close(workers[k].fd);
+        if (workers[k].pid > 0) waitpid(workers[k].pid, NULL, 0);
+    }
+
+    return 0;
+}
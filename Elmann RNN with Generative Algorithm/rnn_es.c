@@ -0,0 +1,297 @@
+/*
+ * EVOLUTION STRATEGIES FOR THE ELMAN RNN
+ *
+ * Included by rnn_ga.c, an alternative to the GA's reproduce():
+ *   ./rnn_ga --optimizer es        OpenAI-style evolution strategy
+ *   ./rnn_ga --optimizer sep-cma   CMA-ES with a diagonal covariance (sep-CMA-ES)
+ *
+ * Instead of a population of separate brains, there is one "mean" brain.
+ * Each generation we try lambda noisy copies of it, score them with the
+ * same evaluate_population() the GA uses, and move the mean toward the
+ * copies that did well.
+ *
+ * The noise for copy k of generation g comes from the random stream
+ * (seed, g, k) in rng.c. We never store it: when it is time to update the
+ * mean, we regenerate it from that address. So however large lambda is,
+ * the optimizer only keeps a handful of gene-sized vectors (plus a fitness
+ * and a rank per copy, on the heap), and the copies are scored
+ * population.size at a time in the existing population arena.
+ */
+
+#define ES_SIGMA    0.1  // starting size of the noise
+#define ES_LEARNING 0.1  // how far the mean moves each generation (OpenAI-ES)
+
+enum { OPT_GA, OPT_ES, OPT_SEP_CMA };
+
+typedef struct {
+    int variant;       // OPT_ES or OPT_SEP_CMA
+    int lambda;        // noisy copies per generation
+    uint64_t seed;
+    double sigma;
+
+    double mean[TOTAL_WEIGHTS];
+    double best_gene[TOTAL_WEIGHTS];  // best copy seen so far
+    double best_fitness;
+
+    // sep-CMA-ES only: per-weight variance and the two evolution paths
+    double c[TOTAL_WEIGHTS];
+    double path_sigma[TOTAL_WEIGHTS];
+    double path_c[TOTAL_WEIGHTS];
+
+    // lambda entries each, on the heap: lambda is whatever the user asks for
+    double *fitness;
+    int *order;
+    double *recombination;   // sep-CMA-ES: weight of the i-th best copy
+} ES;
+
+ES es;
+
+// scratch vectors, reused for every regenerated sample
+double es_noise[TOTAL_WEIGHTS];
+double es_step[TOTAL_WEIGHTS];
+double es_step2[TOTAL_WEIGHTS];
+double es_z_sum[TOTAL_WEIGHTS];
+
+/*
+ * es_sample
+ * Regenerate the noise of copy k in generation gen and build the copy.
+ *
+ * OpenAI-ES uses antithetic pairs: copies 2p and 2p + 1 share one noise
+ * vector with opposite signs, which cancels out a lot of the luck.
+ * sep-CMA-ES stretches the noise per weight by sqrt(c).
+ *
+ * z receives the raw noise, gene the copy (either may be NULL).
+ */
+void es_sample(int gen, int k, double *z, double *gene)
+{
+    double *noise = z ? z : es_noise;
+    Rng r;
+
+    if (es.variant == OPT_ES)
+    {
+        r = rng_stream(es.seed, gen, k / 2);
+        rng_gaussians(&r, noise, TOTAL_WEIGHTS);
+        if (k % 2)
+            for (int j = 0; j < TOTAL_WEIGHTS; j++)
+                noise[j] = -noise[j];
+    }
+    else
+    {
+        r = rng_stream(es.seed, gen, k);
+        rng_gaussians(&r, noise, TOTAL_WEIGHTS);
+    }
+
+    if (!gene)
+        return;
+
+    for (int j = 0; j < TOTAL_WEIGHTS; j++)
+    {
+        double y = (es.variant == OPT_SEP_CMA) ? sqrt(es.c[j]) * noise[j] : noise[j];
+        gene[j] = es.mean[j] + es.sigma * y;
+    }
+}
+
+/*
+ * es_score
+ * Score all lambda copies of this generation, population.size at a time,
+ * through evaluate_population(). Only the fitness values are kept.
+ */
+void es_score(int gen, double *fitness)
+{
+    for (int start = 0; start < es.lambda; start += population.size)
+    {
+        int count = es.lambda - start < population.size ? es.lambda - start : population.size;
+
+        for (int i = 0; i < count; i++)
+            es_sample(gen, start + i, NULL, GENE(i));
+        for (int i = count; i < population.size; i++) // unused slots, scored and ignored
+            memcpy(GENE(i), es.mean, sizeof(es.mean));
+
+        evaluate_population();
+
+        for (int i = 0; i < count; i++)
+        {
+            fitness[start + i] = population.fitness[i];
+            if (population.fitness[i] > es.best_fitness)
+            {
+                es.best_fitness = population.fitness[i];
+                memcpy(es.best_gene, GENE(i), sizeof(es.best_gene));
+            }
+        }
+    }
+}
+
+// best fitness first; equal ones in copy order, so runs repeat exactly
+int by_fitness(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    if (es.fitness[x] != es.fitness[y])
+        return es.fitness[x] > es.fitness[y] ? -1 : 1;
+    return x < y ? -1 : 1;
+}
+
+// es.order[] = copy indices from best to worst
+void es_rank()
+{
+    for (int k = 0; k < es.lambda; k++)
+        es.order[k] = k;
+    qsort(es.order, es.lambda, sizeof(int), by_fitness);
+}
+
+/*
+ * es_update_openai
+ * Fitness shaping: only the rank of a copy matters, not its raw fitness.
+ * The best copy gets utility +0.5, the worst -0.5, evenly spaced between.
+ * The mean moves along sum(utility * noise), an estimate of the direction
+ * that increases fitness.
+ */
+void es_update_openai(int gen, const int *order)
+{
+    memset(es_step, 0, sizeof(es_step));
+
+    for (int rank = 0; rank < es.lambda; rank++)
+    {
+        double utility = 0.5 - (double)rank / (es.lambda - 1);
+
+        es_sample(gen, order[rank], es_noise, NULL);
+        for (int j = 0; j < TOTAL_WEIGHTS; j++)
+            es_step[j] += utility * es_noise[j];
+    }
+
+    for (int j = 0; j < TOTAL_WEIGHTS; j++)
+        es.mean[j] += ES_LEARNING / (es.lambda * es.sigma) * es_step[j];
+}
+
+/*
+ * es_update_sep_cma
+ * sep-CMA-ES (Ros and Hansen, 2008): CMA-ES where the covariance is kept
+ * diagonal, one variance per weight, so it stays O(weights).
+ *
+ * The best mu = lambda / 2 copies are recombined with log-decreasing weights.
+ * Two running averages of recent steps ("paths") decide whether the noise
+ * should grow or shrink overall (sigma) and along each weight (c).
+ */
+void es_update_sep_cma(int gen, const int *order)
+{
+    const double n = TOTAL_WEIGHTS;
+    int mu = es.lambda / 2;
+    double *w = es.recombination, wsum = 0.0, w2sum = 0.0;
+
+    for (int i = 0; i < mu; i++)
+    {
+        w[i] = log(mu + 0.5) - log(i + 1.0);
+        wsum += w[i];
+    }
+    for (int i = 0; i < mu; i++)
+    {
+        w[i] /= wsum;
+        w2sum += w[i] * w[i];
+    }
+
+    double mueff = 1.0 / w2sum;
+    double cs = (mueff + 2.0) / (n + mueff + 5.0);
+    double ds = 1.0 + 2.0 * fmax(0.0, sqrt((mueff - 1.0) / (n + 1.0)) - 1.0) + cs;
+    double cc = 4.0 / (n + 4.0);
+    double c1 = 2.0 / ((n + 1.3) * (n + 1.3) + mueff) * (n + 2.0) / 3.0;
+    double cmu = fmin(1.0 - c1, 2.0 * (mueff - 2.0 + 1.0 / mueff) / ((n + 2.0) * (n + 2.0) + mueff) * (n + 2.0) / 3.0);
+    double chi_n = sqrt(n) * (1.0 - 1.0 / (4.0 * n) + 1.0 / (21.0 * n * n));
+
+    // weighted sums of the regenerated noise z, the step y = sqrt(c) z, and y^2
+    memset(es_z_sum, 0, sizeof(es_z_sum));
+    memset(es_step, 0, sizeof(es_step));
+    memset(es_step2, 0, sizeof(es_step2));
+
+    for (int i = 0; i < mu; i++)
+    {
+        es_sample(gen, order[i], es_noise, NULL);
+        for (int j = 0; j < TOTAL_WEIGHTS; j++)
+        {
+            double y = sqrt(es.c[j]) * es_noise[j];
+            es_z_sum[j] += w[i] * es_noise[j];
+            es_step[j] += w[i] * y;
+            es_step2[j] += w[i] * y * y;
+        }
+    }
+
+    double ps_norm = 0.0;
+    for (int j = 0; j < TOTAL_WEIGHTS; j++)
+    {
+        es.mean[j] += es.sigma * es_step[j];
+        es.path_sigma[j] = (1.0 - cs) * es.path_sigma[j] + sqrt(cs * (2.0 - cs) * mueff) * es_z_sum[j];
+        ps_norm += es.path_sigma[j] * es.path_sigma[j];
+    }
+    ps_norm = sqrt(ps_norm);
+
+    // stall the variance path while sigma is growing fast
+    int hsig = ps_norm / sqrt(1.0 - pow(1.0 - cs, 2.0 * (gen + 1))) < (1.4 + 2.0 / (n + 1.0)) * chi_n;
+
+    // a stalled path would shrink c, so give back what it would have added
+    double c_stall = (1 - hsig) * c1 * cc * (2.0 - cc);
+
+    for (int j = 0; j < TOTAL_WEIGHTS; j++)
+    {
+        es.path_c[j] = (1.0 - cc) * es.path_c[j] + hsig * sqrt(cc * (2.0 - cc) * mueff) * es_step[j];
+        es.c[j] = (1.0 - c1 - cmu + c_stall) * es.c[j] + c1 * es.path_c[j] * es.path_c[j] + cmu * es_step2[j];
+    }
+
+    es.sigma *= exp(cs / ds * (ps_norm / chi_n - 1.0));
+}
+
+/*
+ * es_run
+ * Start the mean at the same kind of random brain the GA starts with and
+ * run the chosen strategy. Afterwards chromosome 0 holds the mean and
+ * chromosome 1 the best copy ever scored, for main() to pick from.
+ */
+void es_run(int variant, int lambda, uint64_t seed, int generations)
+{
+    es.variant = variant;
+    es.lambda = lambda;
+    es.seed = seed;
+    es.sigma = ES_SIGMA;
+    es.best_fitness = -1.0;
+    es.fitness = malloc(lambda * sizeof(double));
+    es.order = malloc(lambda * sizeof(int));
+    es.recombination = malloc(lambda * sizeof(double));
+    if (!es.fitness || !es.order || !es.recombination)
+    {
+        fprintf(stderr, "not enough memory for lambda = %d\n", lambda);
+        exit(1);
+    }
+
+    Rng r = rng_stream(seed, ~0ull, 0);
+    for (int j = 0; j < TOTAL_WEIGHTS; j++)
+    {
+        es.mean[j] = rng_uniform(&r) * 2.0 - 1.0;
+        es.c[j] = 1.0;
+        es.path_sigma[j] = 0.0;
+        es.path_c[j] = 0.0;
+    }
+
+#ifdef RECURRENT_DEGREE
+    // sparse networks: the strategies only move weights, every copy keeps one set of connections
+    random_connections(&r, CONNECTIONS(0));
+    for (int i = 1; i < population.size; i++)
+        memcpy(CONNECTIONS(i), CONNECTIONS(0), TOTAL_CONNECTIONS * sizeof(int));
+#endif
+
+    for (int gen = 0; gen < generations; gen++)
+    {
+        es_score(gen, es.fitness);
+        es_rank();
+
+        if (variant == OPT_ES)
+            es_update_openai(gen, es.order);
+        else
+            es_update_sep_cma(gen, es.order);
+
+        printf("Generation %d complete (best %f, sigma %f)\n", gen, es.best_fitness, es.sigma);
+    }
+
+    memcpy(GENE(0), es.mean, sizeof(es.mean));
+    memcpy(GENE(1), es.best_gene, sizeof(es.best_gene));
+
+    free(es.fitness);
+    free(es.order);
+    free(es.recombination);
+}
@@ -1,8 +1,18 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // CPU affinity and huge pages in population.c
+#endif
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64 // history files past 2 GiB on 32-bit systems, see history.c
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "elmann_rnn.c"
+#include "rng.c"
+#include "history.c"
 
 /*
  * GENETIC ALGORITHM TRAINER FOR ELMAN RNN
@@ -11,78 +21,219 @@
  * we treat the RNN weights like DNA and evolve them over generations.
  *
  * The idea:
- *   1. Start with 50 random brains (each brain = 168 weights)
+ *   1. Start with 50 random brains (--pop to change) (each brain = 168 weights with the default
+ *      single hidden layer, TOTAL_WEIGHTS in general)
  *   2. Test each brain on a task (predict the next number in a sequence)
  *   3. Better brains are more likely to reproduce
  *   4. Children inherit mixed weights from two parents, with small random mutations
  *   5. Repeat 100 times, the population gets smarter each generation
  *
- * The task we are training on:
- *   The sequence 0 1 2 0 1 2 0 1 2
+ * The tasks we are training on:
+ *   Repeating sequences like 0 1 2 0 1 2 0 1 2 (see TASK SUITE below)
  *   Given the current number, predict the next one.
- *   This loops, so the RNN must remember context to do it well.
+ *   These loop, so the RNN must remember context to do it well.
  */
 
-#define POP_SIZE 50       // How many RNNs we evolve in parallel
+#ifndef POP_SIZE
+#define POP_SIZE 50       // How many RNNs we evolve in parallel, unless --pop says otherwise
+#endif
+#ifndef GENERATIONS
 #define GENERATIONS 100   // How many rounds of evolution
+#endif
+#ifndef MUTATION_RATE
 #define MUTATION_RATE 0.05 // 5% chance any single weight gets nudged
+#endif
+#ifndef MUTATION_SIZE
+#define MUTATION_SIZE 0.1  // a nudge is anywhere between -0.1 and +0.1
+#endif
+#ifndef REWIRE_RATE
+#define REWIRE_RATE 0.02   // sparse networks: chance a hidden neuron swaps one connection per child
+#endif
+
+#define MAX_TASKS 8      // most tasks in the suite (see TASK SUITE below)
+
+// The defaults above, changeable at run time (--generations, --mutation-rate, --mutation-size)
+int generations = GENERATIONS;
+double mutation_rate = MUTATION_RATE;
+double mutation_size = MUTATION_SIZE;
 
 /*
- * A Chromosome represents one candidate RNN.
- * gene[] holds all 168 weights as a flat array.
- * fitness measures how well it predicts the sequence.
+ * A chromosome represents one candidate RNN.
+ * GENE(i) is its TOTAL_WEIGHTS weights as a flat array.
+ * population.fitness[i] measures how well it predicts the sequences.
  * Higher fitness = smaller prediction error.
+ * How they are stored is explained in population.c.
  */
-typedef struct {
-    double gene[TOTAL_WEIGHTS];
-    double fitness;
-} Chromosome;
+#include "population.c"
+#include "profile.c"
+
+/*
+ * random_gene
+ * Random weights between -1 and 1, drawn from a random stream (rng.c).
+ */
+void random_gene(Rng *r, double *gene)
+{
+    for (int j = 0; j < TOTAL_WEIGHTS; j++)
+        gene[j] = rng_uniform(r) * 2.0 - 1.0;
+}
+
+#define RNG_STEP 0x9e3779b97f4a7c15ull // how far rng_next() moves a stream
+
+#ifdef RECURRENT_DEGREE
+/*
+ * SPARSE CONNECTIONS
+ * With RECURRENT_DEGREE set (see elmann_rnn.c), every chromosome also has a
+ * list of which context neuron each recurrent weight reads: CONNECTIONS(i),
+ * RECURRENT_DEGREE entries per hidden neuron. Within a neuron they are kept
+ * in increasing order, so a step reads the context front to back.
+ */
+#define CONNECTION_ROWS (HIDDEN_LAYERS * HIDDEN_NEURONS)
+
+static void sort_row(int *col, double *w)
+{
+    for (int k = 1; k < RECURRENT_DEGREE; k++)
+        for (int m = k; m > 0 && col[m - 1] > col[m]; m--)
+        {
+            int c = col[m]; col[m] = col[m - 1]; col[m - 1] = c;
+            if (w) { double t = w[m]; w[m] = w[m - 1]; w[m - 1] = t; }
+        }
+}
+
+// the recurrent weights of connection row r (hidden neuron r % HIDDEN_NEURONS of layer r / HIDDEN_NEURONS)
+static double *recurrent_weights(double *gene, int r)
+{
+    int l = r / HIDDEN_NEURONS, i = r % HIDDEN_NEURONS;
+    return gene + LAYER_WEIGHT_OFFSET(l) + i * LAYER_WIDTH(l) + LAYER_INPUTS(l);
+}
+
+// every hidden neuron reads RECURRENT_DEGREE different context neurons, picked at random
+void random_connections(Rng *r, int *cols)
+{
+    int pick[HIDDEN_NEURONS];
+
+    for (int row = 0; row < CONNECTION_ROWS; row++)
+    {
+        int *col = cols + row * RECURRENT_DEGREE;
+
+        // the first RECURRENT_DEGREE steps of a shuffle
+        for (int c = 0; c < HIDDEN_NEURONS; c++)
+            pick[c] = c;
+        for (int k = 0; k < RECURRENT_DEGREE; k++)
+        {
+            int m = k + rng_next(r) % (HIDDEN_NEURONS - k);
+            int c = pick[k]; pick[k] = pick[m]; pick[m] = c;
+            col[k] = pick[k];
+        }
+        sort_row(col, NULL);
+    }
+}
+
+/*
+ * inherit_connections
+ * A recurrent weight and the column it reads belong together, so each
+ * column comes from the parent its weight came from (the same coin,
+ * regenerated from the same position in the stream as in cross_weights()).
+ * Two slots of a row may end up reading the same neuron; their weights
+ * then simply add up.
+ */
+static void inherit_connections(const int *c1, const int *c2, uint64_t base, int *child)
+{
+    for (int row = 0; row < CONNECTION_ROWS; row++)
+    {
+        int l = row / HIDDEN_NEURONS, i = row % HIDDEN_NEURONS;
+        int first = LAYER_WEIGHT_OFFSET(l) + i * LAYER_WIDTH(l) + LAYER_INPUTS(l);
+
+        for (int k = 0; k < RECURRENT_DEGREE; k++)
+        {
+            int j = first + k;
+            uint64_t bits = mix64(base + (uint64_t)(j + 1) * RNG_STEP);
+            int at = row * RECURRENT_DEGREE + k;
+
+            child[at] = (bits >> 63) ? c1[at] : c2[at];
+        }
+    }
+}
+
+/*
+ * rewire
+ * The structural mutation. With probability REWIRE_RATE per hidden neuron,
+ * remove its weakest connection and add one to a context neuron it does not
+ * read yet. The new connection starts at weight 0, so the child behaves like
+ * before until normal mutation gives it a weight. The number of connections
+ * never changes, so the gene keeps its length.
+ */
+static void rewire(Rng *r, double *gene, int *cols)
+{
+    for (int row = 0; row < CONNECTION_ROWS; row++)
+    {
+        if (rng_uniform(r) >= REWIRE_RATE)
+            continue;
+
+        int *col = cols + row * RECURRENT_DEGREE;
+        double *w = recurrent_weights(gene, row);
+
+        int weakest = 0;
+        for (int k = 1; k < RECURRENT_DEGREE; k++)
+            if (fabs(w[k]) < fabs(w[weakest]))
+                weakest = k;
 
-Chromosome population[POP_SIZE];     // current generation
-Chromosome new_population[POP_SIZE]; // next generation (built during reproduction)
+        int target, taken;
+        do
+        {
+            target = rng_next(r) % HIDDEN_NEURONS;
+            taken = 0;
+            for (int k = 0; k < RECURRENT_DEGREE; k++)
+                taken |= (k != weakest && col[k] == target);
+        } while (taken);
+
+        col[weakest] = target;
+        w[weakest] = 0.0;
+        sort_row(col, w);
+    }
+}
+#endif
 
 /*
  * init_population
  * Give every RNN in the population random weights between -1 and 1.
  * This is generation zero, pure randomness, no skill yet.
+ * RNN i draws from the stream (seed, ~0, i), so the same seed always gives
+ * the same starting population.
  */
-void init_population()
+void init_population(uint64_t seed)
 {
-    for (int i = 0; i < POP_SIZE; i++)
+    for (int i = 0; i < population.size; i++)
     {
-        for (int j = 0; j < TOTAL_WEIGHTS; j++)
-        {
-            population[i].gene[j] =
-                ((double)rand() / RAND_MAX) * 2.0 - 1.0;
-        }
-        population[i].fitness = 0.0;
+        Rng r = rng_stream(seed, ~0ull, i);
+        random_gene(&r, GENE(i));
+#ifdef RECURRENT_DEGREE
+        random_connections(&r, CONNECTIONS(i));
+#endif
+        population.fitness[i] = 0.0;
     }
 }
 
 /*
  * load_weights
  * The GA stores all weights as a flat array (gene[]).
- * The RNN needs them as 2D matrices.
- * This function unpacks the flat array into the weight matrices.
+ * The RNN keeps them in exactly the same flat order (see WEIGHT LAYOUT
+ * in elmann_rnn.c), so unpacking is a straight copy.
  *
- * Order: input->hidden weights, then hidden->hidden, then hidden->output.
+ * Order: for each hidden layer, one row per neuron holding its input weights
+ * followed by its recurrent weights; then hidden->output.
  */
-void load_weights(double *gene)
+void load_weights(const double *gene)
 {
-    int index = 0;
-
-    for (int i = 0; i < HIDDEN_NEURONS; i++)
-        for (int j = 0; j < INPUT_NEURONS + 1; j++)
-            w_input_hidden[i][j] = gene[index++];
-
-    for (int i = 0; i < HIDDEN_NEURONS; i++)
-        for (int j = 0; j < HIDDEN_NEURONS; j++)
-            w_hidden_hidden[i][j] = gene[index++];
+    memcpy(weights, gene, sizeof(weights));
+}
 
-    for (int i = 0; i < OUTPUT_NEURONS; i++)
-        for (int j = 0; j < HIDDEN_NEURONS; j++)
-            w_hidden_output[i][j] = gene[index++];
+#ifdef RECURRENT_DEGREE
+// sparse networks: which context neurons the loaded weights read
+void load_connections(const int *cols)
+{
+    memcpy(connections, cols, sizeof(connections));
 }
+#endif
 
 /*
  * select_parent
@@ -90,12 +241,70 @@ void load_weights(double *gene)
  * This gives fitter individuals a higher chance to reproduce,
  * but does not completely exclude weaker ones (keeps diversity).
  */
-int select_parent()
+int select_parent(Rng *r)
 {
-    int a = rand() % POP_SIZE;
-    int b = rand() % POP_SIZE;
+    int a = rng_next(r) % population.size;
+    int b = rng_next(r) % population.size;
 
-    return (population[a].fitness > population[b].fitness) ? a : b;
+    return (population.fitness[a] > population.fitness[b]) ? a : b;
+}
+
+/*
+ * make_child
+ * Build chromosome child of the next generation from chromosomes p1 and p2
+ * of this one.
+ *
+ * For each weight, randomly inherit from parent 1 or parent 2 (crossover),
+ * and with 5% probability (mutation_rate) nudge it by a small random value
+ * between -0.1 and +0.1 (mutation_size). The nudge prevents the population
+ * from getting stuck.
+ *
+ * Every weight needs three random things: the coin, the 5% chance and the
+ * nudge. All three come out of one 64 bit number:
+ *   bit 63         the coin
+ *   bits 32 - 62   the chance, compared against mutation_rate * 2^31
+ *   bits 0 - 31    the nudge
+ * A stream's numbers can be computed straight from their position
+ * (see rng_next), so weight j takes number j + 1 without waiting for
+ * the ones before it. With no if per weight either, the compiler turns
+ * the loop into vector code: several weights at once, picked with masks.
+ *
+ * Sparse networks only change the weights of connections they already
+ * have, so the gene stays short. Which neurons are connected changes
+ * through rewire().
+ *
+ * Given the same parents and the same stream it always builds the same
+ * child, so a child can be rebuilt anywhere from (parent 1, parent 2, seed)
+ * without sending its weights around (see rnn_dist.c).
+ */
+static void cross_weights(const double *restrict p1, const double *restrict p2, uint64_t base,
+                          double *restrict child)
+{
+    const uint32_t mutate_below = (uint32_t)(fmin(mutation_rate, 1.0) * 0x1p31);
+    const double nudge_scale = mutation_size / 0x1p31;
+
+    for (int j = 0; j < TOTAL_WEIGHTS; j++)
+    {
+        uint64_t bits = mix64(base + (uint64_t)(j + 1) * RNG_STEP);
+
+        double nudge = (int32_t)(uint32_t)bits * nudge_scale; // -size to +size
+        double mutate = (uint32_t)(bits >> 32 & 0x7fffffff) < mutate_below; // 1 or 0
+
+        child[j] = ((bits >> 63) ? p1[j] : p2[j]) + mutate * nudge;
+    }
+}
+
+void make_child(int p1, int p2, Rng *r, int child)
+{
+    const uint64_t base = r->state;
+
+    cross_weights(GENE(p1), GENE(p2), base, NEW_GENE(child));
+    r->state = base + (uint64_t)TOTAL_WEIGHTS * RNG_STEP; // as if rng_next() had run once per weight
+
+#ifdef RECURRENT_DEGREE
+    inherit_connections(CONNECTIONS(p1), CONNECTIONS(p2), base, NEW_CONNECTIONS(child));
+    rewire(r, NEW_GENE(child), NEW_CONNECTIONS(child));
+#endif
 }
 
 /*
@@ -104,131 +313,462 @@ int select_parent()
  *
  * For each new child:
  *   - Pick two parents via tournament selection
- *   - For each weight, randomly inherit from parent 1 or parent 2 (crossover)
- *   - With 5% probability, nudge that weight slightly (mutation)
+ *   - Build it from them with make_child()
  *
- * Mutation adds a small random value between -0.1 and +0.1.
- * This prevents the population from getting stuck.
+ * Child i of generation gen gets all of its randomness, tournaments
+ * included, from the stream (seed, gen, i). So children do not depend on
+ * each other and every thread builds its own slice of the new generation
+ * (see population.c). The result is the same for any number of threads.
  *
- * After building new_population, replace the old one.
+ * After building the new generation, it replaces the old one.
  */
-void reproduce()
+typedef struct {
+    uint64_t seed;
+    int gen;
+} Generation;
+
+void reproduce_slice(int start, int end, void *arg)
 {
-    for (int i = 0; i < POP_SIZE; i++)
+    const Generation *g = arg;
+
+    for (int i = start; i < end; i++)
     {
-        int p1 = select_parent();
-        int p2 = select_parent();
+        Rng r = rng_stream(g->seed, g->gen, i);
+        int p1 = select_parent(&r);
+        int p2 = select_parent(&r);
 
-        for (int j = 0; j < TOTAL_WEIGHTS; j++)
+        make_child(p1, p2, &r, i);
+    }
+}
+
+void reproduce(uint64_t seed, int gen)
+{
+    Generation g = {seed, gen};
+
+    profile_slices(PHASE_REPRODUCE, reproduce_slice, &g, 1);
+    swap_generations();
+}
+
+/*
+ * TASK SUITE
+ * Scoring on a single sequence lets the GA simply memorize 0 1 2.
+ * Instead every network is scored on a suite of tasks: different periods,
+ * different lengths, and one with noisy inputs.
+ *
+ * Each task is an input sequence and the numbers we expect after each input.
+ * For clean tasks target[t] is just input[t + 1]. In the noisy task some
+ * inputs are swapped for random numbers, but the targets stay clean, so the
+ * network has to lean on its memory instead of the current input.
+ *
+ * Numbers go up to 5, which is what the 6 input and 6 output neurons allow.
+ */
+#define MAX_TASK_LEN 32
+
+typedef struct {
+    const char *name;
+    int length;                  // number of prediction steps
+    int input[MAX_TASK_LEN];
+    int target[MAX_TASK_LEN];
+    double weight;               // how much this task counts in the overall fitness
+} Task;
+
+Task tasks[MAX_TASKS];
+int task_count = 0;
+int task_order[MAX_TASKS]; // longest task first, the order lanes pick them up in
+
+/*
+ * add_task
+ * Repeat pattern[] until there are length + 1 numbers, then replace each
+ * input with a random number with probability noise. The noise comes from a
+ * fixed-seed generator so every run (and every chromosome) sees the same task.
+ */
+void add_task(const char *name, const int *pattern, int period, int length, double noise)
+{
+    Task *task = &tasks[task_count++];
+    unsigned int lcg = 12345u + task_count;
+
+    task->name = name;
+    task->length = length;
+    task->weight = 1.0;
+
+    for (int t = 0; t < length; t++)
+    {
+        task->input[t] = pattern[t % period];
+        task->target[t] = pattern[(t + 1) % period];
+
+        lcg = lcg * 1103515245u + 12345u;
+        if ((lcg >> 16) % 1000 < noise * 1000)
         {
-            // crossover: flip a coin to pick which parent this weight comes from
-            if (rand() % 2)
-                new_population[i].gene[j] = population[p1].gene[j];
-            else
-                new_population[i].gene[j] = population[p2].gene[j];
+            lcg = lcg * 1103515245u + 12345u;
+            task->input[t] = (lcg >> 16) % OUTPUT_NEURONS;
+        }
+    }
+}
 
-            // mutation: occasionally nudge the weight slightly
-            if (((double)rand() / RAND_MAX) < MUTATION_RATE)
-                new_population[i].gene[j] +=
-                    ((double)rand() / RAND_MAX) * 0.2 - 0.1;
+/*
+ * order_tasks
+ * Longest task first, so the short tasks fill in behind them
+ * when evaluate_chromosome() hands tasks to its lanes.
+ */
+void order_tasks()
+{
+    for (int t = 0; t < task_count; t++)
+    {
+        int j = t;
+        while (j > 0 && tasks[task_order[j - 1]].length < tasks[t].length)
+        {
+            task_order[j] = task_order[j - 1];
+            j--;
         }
+        task_order[j] = t;
     }
+}
 
-    for (int i = 0; i < POP_SIZE; i++)
-        population[i] = new_population[i];
+void build_task_suite()
+{
+    static const int p012[] = {0, 1, 2};
+    static const int p0123[] = {0, 1, 2, 3};
+    static const int p0121[] = {0, 1, 2, 1};
+    static const int p001122[] = {0, 0, 1, 1, 2, 2};
+    static const int p012345[] = {0, 1, 2, 3, 4, 5};
+
+    task_count = 0;
+    add_task("0 1 2", p012, 3, 8, 0.0); // the original task
+    add_task("0 1 2 3", p0123, 4, 15, 0.0);
+    add_task("0 1 2 1", p0121, 4, 15, 0.0); // after 1 comes 2 or 0: needs memory
+    add_task("0 0 1 1 2 2", p001122, 6, 23, 0.0);
+    add_task("0 1 2 3 4 5", p012345, 6, 23, 0.0);
+    add_task("0 1 2 noisy", p012, 3, 31, 0.1);
+
+    order_tasks();
 }
 
 /*
- * evaluate_population
- * Score every RNN in the population.
+ * evaluate_chromosome
+ * Score one set of weights on every task.
  *
- * We feed each RNN the sequence 0 1 2 0 1 2 0 1 2 one step at a time.
- * At each step we give it the current number and ask it to predict the next.
- * We measure how wrong it is (squared error).
+ * The tasks are independent sequences that share the same weights, so they
+ * run side by side in LANES lanes: each lane has its own memory, and every
+ * weight is read once per step and applied to all lanes before moving on.
+ * The memory is stored "sideways", z[j][s] = entry j of lane s, so the inner
+ * loop over lanes is a short fixed-length run the compiler turns into a few
+ * vector instructions. Running 8 sequences costs little more than running 1.
  *
- * Fitness = 1 / (1 + total_error)
- * So fitness is always between 0 and 1.
- * Perfect prediction = fitness close to 1.
- * Terrible prediction = fitness close to 0.
+ * When a lane finishes its task it clears its memory and picks up the next
+ * task that has not started, so lanes stay busy when tasks differ in length
+ * or there are more tasks than lanes.
  *
- * The input is one-hot encoded:
- *   input[0] = 1.0 always (bias neuron)
- *   input[1] = 1 if current letter is 0, else 0
- *   input[2] = 1 if current letter is 1, else 0
- *   input[3] = 1 if current letter is 2, else 0
- *   (inputs 4 and 5 unused in this task, available for extension)
+ * Sparse networks (RECURRENT_DEGREE) read their context through cols[],
+ * the chromosome's CONNECTIONS(). Each connection is still one load of all
+ * lanes side by side, so the sparse product is as vectorized as the dense
+ * one and costs RECURRENT_DEGREE instead of HIDDEN_NEURONS per neuron.
+ * Dense networks ignore cols.
+ *
+ * Writes each task's fitness into task_fit[] and returns the weighted average.
+ * Uses only local memory, so it is safe to call for many chromosomes at once.
  */
-void evaluate_population()
+#define LANES 8
+
+double evaluate_chromosome(const double *gene, const int *cols, double *task_fit)
 {
-    for (int i = 0; i < POP_SIZE; i++)
+    double z[STATE_SIZE][LANES];
+    double h[HIDDEN_NEURONS][LANES];
+    double sum[LANES], out[LANES];
+    double error[MAX_TASKS];
+    int lane_task[LANES];  // task running in each lane, -1 when the lane is idle
+    int lane_t[LANES];     // step that lane is at
+    int next_task = 0, running = 0;
+
+    for (int j = 0; j < STATE_SIZE; j++)
+        for (int s = 0; s < LANES; s++)
+            z[j][s] = 0.0;
+
+    for (int s = 0; s < LANES; s++)
     {
-        load_weights(population[i].gene);
-        reset_context(); // clear RNN memory before each evaluation
+        lane_task[s] = -1;
+        lane_t[s] = 0;
+    }
 
-        double total_error = 0.0;
+    for (int t = 0; t < task_count; t++)
+        error[t] = 0.0;
 
-        int sequence[] = {0, 1, 2, 0, 1, 2, 0, 1, 2};
-        int length = 9;
+    for (;;)
+    {
+        // give every idle lane the next task, with fresh memory
+        for (int s = 0; s < LANES; s++)
+        {
+            if (lane_task[s] >= 0 || next_task >= task_count)
+                continue;
+
+            lane_task[s] = task_order[next_task++];
+            lane_t[s] = 0;
+            running++;
+            for (int l = 0; l < HIDDEN_LAYERS; l++)
+            {
+                for (int i = 0; i < HIDDEN_NEURONS; i++)
+                    z[LAYER_STATE_OFFSET(l) + LAYER_INPUTS(l) + i][s] = 0.0;
+                if (l > 0)
+                    z[LAYER_STATE_OFFSET(l)][s] = 1.0; // bias of the upper layers
+            }
+        }
+
+        if (running == 0)
+            break;
+
+        // one-hot encode the current input of every lane
+        for (int j = 0; j < INPUT_NEURONS + 1; j++)
+            for (int s = 0; s < LANES; s++)
+                z[j][s] = 0.0;
+        for (int s = 0; s < LANES; s++)
+        {
+            z[0][s] = 1.0; // bias always on
+            if (lane_task[s] >= 0)
+                z[tasks[lane_task[s]].input[lane_t[s]] + 1][s] = 1.0;
+        }
 
-        for (int t = 0; t < length - 1; t++)
+        // hidden layers: the same fused [x ; context] rows as RNN_step()
+        for (int l = 0; l < HIDDEN_LAYERS; l++)
         {
-            for (int j = 0; j < INPUT_NEURONS + 1; j++)
-                input[j] = 0.0;
+            const double *w = gene + LAYER_WEIGHT_OFFSET(l);
+            double (*zl)[LANES] = z + LAYER_STATE_OFFSET(l);
 
-            input[0] = 1.0;                  // bias always on
-            input[sequence[t] + 1] = 1.0;   // one-hot encode current step
+            for (int i = 0; i < HIDDEN_NEURONS; i++)
+            {
+                const double *row = w + i * LAYER_WIDTH(l);
+
+                for (int s = 0; s < LANES; s++)
+                    sum[s] = 0.0;
+#ifdef RECURRENT_DEGREE
+                const int *col = cols + (l * HIDDEN_NEURONS + i) * RECURRENT_DEGREE;
+                double (*ctx)[LANES] = zl + LAYER_INPUTS(l);
+
+                for (int j = 0; j < LAYER_INPUTS(l); j++)
+                    for (int s = 0; s < LANES; s++)
+                        sum[s] += row[j] * zl[j][s];
+                for (int k = 0; k < RECURRENT_DEGREE; k++)
+                    for (int s = 0; s < LANES; s++)
+                        sum[s] += row[LAYER_INPUTS(l) + k] * ctx[col[k]][s];
+#else
+                (void)cols;
+                for (int j = 0; j < LAYER_WIDTH(l); j++)
+                    for (int s = 0; s < LANES; s++)
+                        sum[s] += row[j] * zl[j][s];
+#endif
+                #pragma GCC unroll 1 // keep it a loop, so it is vectorized rather than unrolled
+                for (int s = 0; s < LANES; s++)
+                    h[i][s] = lane_tanh(sum[s]);
+            }
 
-            RNN_feed_forward();
+            memcpy(zl + LAYER_INPUTS(l), h, sizeof(h));
+            if (l + 1 < HIDDEN_LAYERS)
+                memcpy(z + LAYER_STATE_OFFSET(l + 1) + 1, h, sizeof(h));
+        }
 
-            int target = sequence[t + 1]; // what we expect the RNN to predict
+        // outputs and squared error, for the lanes that are running
+        const double *w_out = gene + OUTPUT_WEIGHT_OFFSET;
+        for (int k = 0; k < OUTPUT_NEURONS; k++)
+        {
+            for (int s = 0; s < LANES; s++)
+                sum[s] = 0.0;
+            for (int j = 0; j < HIDDEN_NEURONS; j++)
+                for (int s = 0; s < LANES; s++)
+                    sum[s] += w_out[k * HIDDEN_NEURONS + j] * h[j][s];
+            #pragma GCC unroll 1 // same as above
+            for (int s = 0; s < LANES; s++)
+                out[s] = lane_sigmoid(sum[s]);
+
+            for (int s = 0; s < LANES; s++)
+            {
+                if (lane_task[s] < 0)
+                    continue;
+                const Task *task = &tasks[lane_task[s]];
+                double expected = (k == task->target[lane_t[s]]) ? 1.0 : 0.0;
+                double diff = expected - out[s];
+                error[lane_task[s]] += diff * diff;
+            }
+        }
 
-            for (int k = 0; k < OUTPUT_NEURONS; k++)
+        // move every lane one step on, freeing the ones that are done
+        for (int s = 0; s < LANES; s++)
+        {
+            if (lane_task[s] < 0)
+                continue;
+            if (++lane_t[s] == tasks[lane_task[s]].length)
             {
-                double expected = (k == target) ? 1.0 : 0.0;
-                double diff = expected - outputs[k];
-                total_error += diff * diff;
+                lane_task[s] = -1;
+                running--;
             }
         }
+    }
 
-        population[i].fitness = 1.0 / (1.0 + total_error);
+    double total = 0.0, total_weight = 0.0;
+    for (int t = 0; t < task_count; t++)
+    {
+        task_fit[t] = 1.0 / (1.0 + error[t]);
+        total += tasks[t].weight * task_fit[t];
+        total_weight += tasks[t].weight;
     }
+
+    return total / total_weight;
 }
 
 /*
- * main
- * The full evolution loop:
- *   1. Seed random number generator
- *   2. Create random initial population
- *   3. For each generation: evaluate fitness, then reproduce
- *   4. After all generations, find the best RNN and demo its predictions
+ * parse_task_weights
+ * "2,1,1" -> the first tasks' weights, the rest keep theirs. A weight below
+ * 0 would reward doing worse on that task, and all weights 0 (or one
+ * infinite) would make every fitness NaN, so these are refused.
+ * Returns 0 and says why if so.
  */
-int main()
+int parse_task_weights(const char *list)
 {
-    srand(time(NULL));
-
-    init_population();
+    double weight[MAX_TASKS], total = 0.0;
+    const char *p = list;
+    char *end;
 
-    for (int gen = 0; gen < GENERATIONS; gen++)
+    for (int t = 0; t < task_count; t++)
+        weight[t] = tasks[t].weight;
+    for (int t = 0; t < task_count && *p; t++)
+    {
+        weight[t] = strtod(p, &end);
+        if (end == p || !(weight[t] >= 0.0) || isinf(weight[t]))
+        {
+            fprintf(stderr, "--weights %s: weights must be numbers >= 0\n", list);
+            return 0;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    for (int t = 0; t < task_count; t++)
+        total += weight[t];
+    if (!(total > 0.0))
     {
-        evaluate_population();
-        reproduce();
-        printf("Generation %d complete\n", gen);
+        fprintf(stderr, "--weights %s: at least one weight must be above 0\n", list);
+        return 0;
     }
 
-    // Find the best individual in the final population
+    for (int t = 0; t < task_count; t++)
+        tasks[t].weight = weight[t];
+    return 1;
+}
+
+// one thread's share of evaluate_population()
+void evaluate_slice(int start, int end, void *arg)
+{
+    (void)arg;
+    for (int i = start; i < end; i++)
+        population.fitness[i] = evaluate_chromosome(GENE(i), CONNECTIONS(i), TASK_FITNESS(i));
+}
+
+/*
+ * evaluate_population
+ * Score every RNN in the population.
+ *
+ * Each task is fed to the RNN one step at a time.
+ * At each step we give it the current number and ask it to predict the next.
+ * We measure how wrong it is (squared error).
+ *
+ * Task fitness = 1 / (1 + total_error on that task)
+ * So fitness is always between 0 and 1.
+ * Perfect prediction = fitness close to 1.
+ * Terrible prediction = fitness close to 0.
+ * The chromosome's fitness is the weighted average over the suite.
+ *
+ * The input is one-hot encoded:
+ *   input[0] = 1.0 always (bias neuron)
+ *   input[1] = 1 if current number is 0, else 0
+ *   input[2] = 1 if current number is 1, else 0
+ *   ...
+ *   input[6] = 1 if current number is 5, else 0
+ *
+ * Every thread scores its own slice of the population (see population.c).
+ * Per-task results land in TASK_FITNESS(i).
+ */
+void evaluate_population()
+{
+    if (task_count == 0)
+        build_task_suite();
+
+    // time steps one chromosome is run for, for the profile
+    long long steps = 0;
+    for (int t = 0; t < task_count; t++)
+        steps += tasks[t].length;
+
+    profile_slices(PHASE_EVALUATE, evaluate_slice, NULL, steps);
+}
+
+// index of the fittest chromosome from the last evaluate_population()
+int best_chromosome()
+{
     int best = 0;
-    for (int i = 1; i < POP_SIZE; i++)
-        if (population[i].fitness > population[best].fitness)
+    for (int i = 1; i < population.size; i++)
+        if (population.fitness[i] > population.fitness[best])
             best = i;
+    return best;
+}
+
+/*
+ * write_history
+ * --history: append the generation just scored (its best, mean and worst
+ * fitness, and the gene of its best chromosome) to the history file.
+ */
+void write_history(HistoryWriter *w, double seconds)
+{
+    int best = best_chromosome();
+    HistoryStats stats = { population.fitness[best], 0.0, population.fitness[best], seconds };
+
+    for (int i = 0; i < population.size; i++)
+    {
+        stats.mean += population.fitness[i];
+        stats.worst = fmin(stats.worst, population.fitness[i]);
+    }
+    stats.mean /= population.size;
+
+    if (!history_append(w, &stats, GENE(best), CONNECTIONS(best)))
+        fprintf(stderr, "could not write the history file\n");
+}
+
+double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/*
+ * wait_for_budget
+ * --stdin-budget: the GA may only run up to *budget generations, then asks
+ * for more on stdout and waits for a new total on stdin. rnn_sweep.c uses
+ * this to pause and resume runs. Returns 0 when stdin closes: stop here.
+ */
+int wait_for_budget(int gen, int *budget)
+{
+    char line[64];
 
-    printf("\nBest fitness: %f\n", population[best].fitness);
+    while (*budget <= gen)
+    {
+        printf("Waiting at generation %d\n", gen);
+        fflush(stdout);
+        if (!fgets(line, sizeof(line), stdin))
+            return 0;
+        *budget = atoi(line);
+    }
+    return 1;
+}
 
-    // Load the best weights into the RNN and run the sequence
-    load_weights(population[best].gene);
+/*
+ * print_demo
+ * Load a gene into the RNN and show what it predicts for 0 1 2 0 1 2 ...
+ */
+void print_demo(const double *gene, const int *cols)
+{
+    load_weights(gene);
+#ifdef RECURRENT_DEGREE
+    load_connections(cols);
+#else
+    (void)cols;
+#endif
     reset_context();
 
     int demo[] = {0, 1, 2, 0, 1, 2, 0, 1, 2};
-    printf("\nPredictions from best individual:\n");
 
     for (int t = 0; t < 8; t++)
     {
@@ -246,6 +786,159 @@ int main()
         printf("Input: %d -> Predicted: %d (expected %d)\n",
                demo[t], predicted, demo[t + 1]);
     }
+}
+
+#include "rnn_es.c"
+
+/*
+ * main
+ * The full evolution loop:
+ *   1. Pick a seed (--seed, or the clock), every random number comes from it
+ *   2. Create random initial population
+ *   3. For each generation: evaluate fitness, then reproduce
+ *   4. After all generations, find the best RNN, show its score on every task
+ *      and demo its predictions
+ *
+ * Options:
+ *   --weights 2,1,1,1,1,1        how much each task counts (in suite order)
+ *   --optimizer ga|es|sep-cma    evolve with the GA (default) or an evolution strategy
+ *   --lambda N                   noisy copies per generation for es / sep-cma
+ *   --pop N                      population size (default POP_SIZE)
+ *   --threads N                  scoring and breeding threads (default: one per CPU)
+ *   --seed S                     same seed, same run, whatever the thread count (default: the time)
+ *   --generations N              rounds of evolution (default GENERATIONS)
+ *   --mutation-rate R            chance a weight is nudged (default MUTATION_RATE)
+ *   --mutation-size S            largest nudge (default MUTATION_SIZE)
+ *   --stdin-budget               GA only: run as many generations as stdin allows (see wait_for_budget)
+ *   --history FILE               GA only: record every generation's best network (history.c)
+ *   --profile                    count cycles, cache and branch misses per phase and thread (profile.c)
+ *
+ * Other tools (rnn_quant.c, rnn_dist.c) include this file to reuse the GA and
+ * define RNN_GA_NO_MAIN to bring their own main.
+ */
+#ifndef RNN_GA_NO_MAIN
+int main(int argc, char **argv)
+{
+    int optimizer = OPT_GA;
+    int lambda = POP_SIZE;
+    int pop_size = POP_SIZE, threads = 0, stdin_budget = 0;
+    uint64_t seed = time(NULL);
+    const char *history_path = NULL;
 
+    RNN_init();
+    build_task_suite();
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--weights") == 0 && a + 1 < argc && parse_task_weights(argv[a + 1]))
+            a++;
+        else if (strcmp(argv[a], "--optimizer") == 0 && a + 1 < argc)
+        {
+            a++;
+            if (strcmp(argv[a], "ga") == 0) optimizer = OPT_GA;
+            else if (strcmp(argv[a], "es") == 0) optimizer = OPT_ES;
+            else if (strcmp(argv[a], "sep-cma") == 0) optimizer = OPT_SEP_CMA;
+            else
+            {
+                fprintf(stderr, "unknown optimizer %s (ga, es or sep-cma)\n", argv[a]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[a], "--lambda") == 0 && a + 1 < argc)
+        {
+            lambda = atoi(argv[++a]);
+            lambda += lambda % 2; // es uses pairs
+            if (lambda < 4) lambda = 4;
+        }
+        else if (strcmp(argv[a], "--pop") == 0 && a + 1 < argc)
+        {
+            pop_size = atoi(argv[++a]);
+            if (pop_size < 2) pop_size = 2;
+        }
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc)
+            threads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc)
+            seed = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--generations") == 0 && a + 1 < argc)
+            generations = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--mutation-rate") == 0 && a + 1 < argc)
+            mutation_rate = atof(argv[++a]);
+        else if (strcmp(argv[a], "--mutation-size") == 0 && a + 1 < argc)
+            mutation_size = atof(argv[++a]);
+        else if (strcmp(argv[a], "--stdin-budget") == 0)
+            stdin_budget = 1;
+        else if (strcmp(argv[a], "--history") == 0 && a + 1 < argc)
+            history_path = argv[++a];
+        else if (strcmp(argv[a], "--profile") == 0)
+            profile_init();
+        else
+        {
+            fprintf(stderr, "usage: %s [--weights w1,w2,...] [--optimizer ga|es|sep-cma] [--lambda N]\n"
+                            "       [--pop N] [--threads N] [--seed S] [--generations N]\n"
+                            "       [--mutation-rate R] [--mutation-size S] [--stdin-budget] [--history FILE]\n"
+                            "       [--profile]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (stdin_budget)
+        setvbuf(stdout, NULL, _IOLBF, 0); // whoever reads the pipe sees every line right away
+
+    if (!alloc_population(pop_size, threads))
+        return 1;
+    print_population_info();
+    printf("Seed %llu\n", (unsigned long long)seed);
+
+    if (optimizer == OPT_GA)
+    {
+        int budget = stdin_budget ? 0 : generations;
+        HistoryWriter history;
+        struct timespec start;
+
+        HistoryHeader shape = { .inputs = INPUT_NEURONS, .hidden = HIDDEN_NEURONS, .layers = HIDDEN_LAYERS,
+                                .outputs = OUTPUT_NEURONS, .weights = TOTAL_WEIGHTS,
+                                .connections = TOTAL_CONNECTIONS };
+        if (history_path && !history_create(&history, history_path, &shape))
+            return 1;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        init_population(seed);
+
+        for (int gen = 0; gen < generations; gen++)
+        {
+            if (!wait_for_budget(gen, &budget))
+                break;
+
+            evaluate_population();
+            double best_fitness = population.fitness[best_chromosome()];
+            if (history_path)
+                write_history(&history, seconds_since(&start));
+            reproduce(seed, gen);
+            printf("Generation %d complete (best %f)\n", gen, best_fitness);
+        }
+
+        if (history_path)
+            history_finish(&history);
+    }
+    else
+        es_run(optimizer, lambda, seed, generations);
+
+    // Score the final population, then find the best individual in it
+    evaluate_population();
+
+    int best = best_chromosome();
+
+    printf("\nBest fitness: %f\n", population.fitness[best]);
+
+    printf("\nPer task:\n");
+    for (int t = 0; t < task_count; t++)
+        printf("  %-14s weight %.2f  fitness %f\n",
+               tasks[t].name, tasks[t].weight, TASK_FITNESS(best)[t]);
+
+    printf("\nPredictions from best individual:\n");
+    print_demo(GENE(best), CONNECTIONS(best));
+
+    print_profile();
     return 0;
-}
\ No newline at end of file
+}
+#endif
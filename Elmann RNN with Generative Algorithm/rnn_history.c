@@ -0,0 +1,148 @@
+#define RNN_GA_NO_MAIN
+#include "rnn_ga.c"
+
+/*
+ * HISTORY VIEWER
+ *
+ * Looks inside a file written by rnn_ga --history (format in history.c).
+ *
+ *   gcc -O2 rnn_history.c -lm -pthread -o rnn_history
+ *   ./rnn_history run.hist                 sizes, length and the fitness curve
+ *   ./rnn_history run.hist --gen 52000     one generation's best network
+ *   ./rnn_history run.hist --gen -1        the last one (negative counts from the end)
+ *   ./rnn_history run.hist --curve 40      the curve with 40 points (default 20)
+ *
+ * --gen reads only the block that generation is in, so it takes about as
+ * long for generation 5 as for generation 5,000,000. The network is scored
+ * on the task suite and run on 0 1 2 ... like at the end of rnn_ga, which
+ * needs this program built for the same network size as the run (the same
+ * -D options). If it was not, only the stats are shown.
+ */
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// was this program compiled for the network in the file?
+int same_network(const HistoryHeader *head)
+{
+    return head->inputs == INPUT_NEURONS && head->hidden == HIDDEN_NEURONS &&
+           head->layers == HIDDEN_LAYERS && head->outputs == OUTPUT_NEURONS &&
+           head->weights == TOTAL_WEIGHTS && head->connections == TOTAL_CONNECTIONS;
+}
+
+void print_summary(History *h, const char *path, int points)
+{
+    const HistoryHeader *head = &h->head;
+
+    fseek(h->f, 0, SEEK_END);
+    long bytes = ftell(h->f);
+
+    printf("%s: %d-%u", path, head->inputs, head->hidden);
+    for (uint32_t l = 1; l < head->layers; l++)
+        printf("-%u", head->hidden);
+    printf("-%u network, %u weights", head->outputs, head->weights);
+    if (head->connections)
+        printf(", %u recurrent connections each", head->connections / (head->layers * head->hidden));
+    printf("\n%d generations in %d blocks of %u, %.1f MB, %.0f bytes per generation (%zu raw)%s\n",
+           h->gens, h->block_count, head->keyframe, bytes / 1048576.0,
+           h->gens ? (double)bytes / h->gens : 0.0,
+           sizeof(HistoryRecord) + head->weights * sizeof(double) + head->connections * sizeof(int),
+           h->recovered ? "\n(no index: the run did not finish, rebuilt it from the records)" : "");
+
+    if (h->gens == 0)
+        return;
+
+    float best[points];
+    int n = history_curve(h, best, points);
+    printf("\n%10s  %s\n", "from gen", "best fitness");
+    for (int k = 0; k < n; k++)
+    {
+        int bar = (int)(best[k] * 50.0f + 0.5f);
+        printf("%10lld  %.4f  %.*s\n", (long long)k * h->gens / n, best[k], bar,
+               "##################################################");
+    }
+}
+
+int show_generation(History *h, int gen)
+{
+    HistoryStats stats;
+    double gene[h->head.weights];
+    int cols[h->head.connections + 1];
+
+    if (gen < 0)
+        gen += h->gens;
+
+    double start = now_seconds();
+    if (!history_read(h, gen, &stats, gene, cols))
+    {
+        fprintf(stderr, "generation %d is not in the file (it has 0 to %d)\n", gen, h->gens - 1);
+        return 0;
+    }
+    double took = now_seconds() - start;
+
+    printf("Generation %d (read in %.3f ms)\n", gen, took * 1e3);
+    printf("  best %f  mean %f  worst %f  at %.1f s into the run\n",
+           stats.best, stats.mean, stats.worst, stats.seconds);
+
+    if (!same_network(&h->head))
+    {
+        printf("\nThis program was built for a different network. To score this one, rebuild with\n"
+               "  -DHIDDEN_NEURONS=%u -DHIDDEN_LAYERS=%u", h->head.hidden, h->head.layers);
+        if (h->head.connections)
+            printf(" -DRECURRENT_DEGREE=%u", h->head.connections / (h->head.layers * h->head.hidden));
+        printf("\n");
+        return 1;
+    }
+
+    double task_fit[MAX_TASKS];
+    double fitness = evaluate_chromosome(gene, cols, task_fit);
+
+    printf("\nPer task (scored again now: %f):\n", fitness);
+    for (int t = 0; t < task_count; t++)
+        printf("  %-14s weight %.2f  fitness %f\n", tasks[t].name, tasks[t].weight, task_fit[t]);
+
+    printf("\nPredictions:\n");
+    print_demo(gene, cols);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    int points = 20, gen = 0, have_gen = 0;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--gen") == 0 && a + 1 < argc)
+        {
+            gen = atoi(argv[++a]);
+            have_gen = 1;
+        }
+        else if (strcmp(argv[a], "--curve") == 0 && a + 1 < argc)
+            points = atoi(argv[++a]);
+        else if (!path && argv[a][0] != '-')
+            path = argv[a];
+        else
+            path = NULL, a = argc;
+    }
+    if (!path || points < 1)
+    {
+        fprintf(stderr, "usage: %s FILE [--gen G] [--curve POINTS]\n", argv[0]);
+        return 1;
+    }
+
+    History h;
+    if (!history_open(&h, path))
+        return 1;
+
+    RNN_init();
+    build_task_suite();
+    int ok = have_gen ? show_generation(&h, gen) : (print_summary(&h, path, points), 1);
+
+    history_close(&h);
+    return ok ? 0 : 1;
+}
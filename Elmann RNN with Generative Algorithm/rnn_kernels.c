@@ -0,0 +1,185 @@
+/*
+ * SPECIALIZED FORWARD KERNELS
+ *
+ * Included by elmann_rnn.c, so every program that includes that file has
+ * these too. RNN_step() runs the kernel for the compiled-in sizes when there
+ * is one, as picked by RNN_init(). Every kernel does one time step of a network with one hidden
+ * layer, on the same gene and the same z = [1 ; x ; context] that RNN_step()
+ * uses, but the sizes may differ from the compiled-in ones:
+ *
+ *   RnnShape shape = { 6, 8, 6 };               // inputs, hidden, outputs
+ *   RnnKernel step = rnn_pick_kernel(&shape, NULL);
+ *   step(&shape, w, z, h, out);
+ *
+ * layer_forward() gets its sizes as arguments, so the compiler has to write
+ * loops that work for any size: it cannot unroll them or keep a layer's sums
+ * in registers. Here DEFINE_RNN_KERNEL stamps out one copy of the step per
+ * shape with the sizes written in as numbers, and the compiler unrolls and
+ * vectorizes each copy for exactly that shape.
+ *
+ * Each shape is compiled twice on x86: once for any x86-64 CPU, once for
+ * CPUs with AVX2 and FMA. rnn_pick_kernel() asks the CPU (cpuid, through
+ * __builtin_cpu_supports) which one it can run. Shapes not in the list
+ * fall back to rnn_step_generic().
+ *
+ * Results match rnn_step_generic() to about 1e-15: the sums are added in the
+ * same order, only tanh and sigmoid come from the lane math in elmann_rnn.c.
+ */
+
+typedef struct {
+    int inputs;   // without the bias
+    int hidden;
+    int outputs;
+} RnnShape;
+
+typedef void (*RnnKernel)(const RnnShape *shape, const double *w, double *z, double *h, double *out);
+
+/*
+ * rnn_step_generic
+ * RNN_step()'s own loops for one hidden layer, with the sizes taken from shape.
+ */
+void rnn_step_generic(const RnnShape *shape, const double *w, double *z, double *h, double *out)
+{
+    int width = shape->inputs + 1 + shape->hidden;
+    const double *w_out = w + shape->hidden * width;
+
+    layer_forward(w, z, shape->hidden, width, h);
+    memcpy(z + shape->inputs + 1, h, shape->hidden * sizeof(double));
+
+    for (int i = 0; i < shape->outputs; i++)
+    {
+        double sum = 0.0;
+
+        for (int j = 0; j < shape->hidden; j++)
+            sum += w_out[i * shape->hidden + j] * h[j];
+
+        out[i] = sigmoid(sum);
+    }
+}
+
+/*
+ * DEFINE_RNN_KERNEL(NAME, I, H, O, TARGET)
+ * The hidden sums are built a column at a time: z[j] times column j of the
+ * weights is added to all H sums at once. Each sum still adds its terms in
+ * the order j = 0, 1, 2, ... like layer_forward(), but now the H sums are
+ * independent of each other and fill a vector register side by side.
+ */
+#define DEFINE_RNN_KERNEL(NAME, I, H, O, TARGET)                                  \
+    TARGET static void NAME(const RnnShape *shape, const double *restrict w,     \
+                            double *restrict z, double *restrict h,              \
+                            double *restrict out)                                \
+    {                                                                            \
+        enum { WIDTH = (I) + 1 + (H) };                                          \
+        const double *w_out = w + (H) * WIDTH;                                   \
+        double sum[H], out_sum[O];                                               \
+        (void)shape;                                                             \
+                                                                                 \
+        for (int i = 0; i < (H); i++)                                            \
+            sum[i] = 0.0;                                                        \
+        for (int j = 0; j < WIDTH; j++)                                          \
+            for (int i = 0; i < (H); i++)                                        \
+                sum[i] += w[i * WIDTH + j] * z[j];                               \
+        for (int i = 0; i < (H); i++)                                            \
+            h[i] = lane_tanh(sum[i]);                                            \
+        for (int i = 0; i < (H); i++)                                            \
+            z[(I) + 1 + i] = h[i];                                               \
+                                                                                 \
+        for (int k = 0; k < (O); k++)                                            \
+            out_sum[k] = 0.0;                                                    \
+        for (int j = 0; j < (H); j++)                                            \
+            for (int k = 0; k < (O); k++)                                        \
+                out_sum[k] += w_out[k * (H) + j] * h[j];                         \
+        for (int k = 0; k < (O); k++)                                            \
+            out[k] = lane_sigmoid(out_sum[k]);                                   \
+    }
+
+/*
+ * RNN_KERNEL_SHAPES
+ * The shapes that get their own kernels: the default network, the sizes
+ * the visualizer lets you click through, and a couple of bigger ones.
+ * Add a line here to specialize another shape.
+ */
+#define RNN_KERNEL_SHAPES(X) \
+    X(6, 4, 6)               \
+    X(6, 6, 6)               \
+    X(6, 8, 6)               \
+    X(6, 10, 6)              \
+    X(6, 12, 6)              \
+    X(6, 16, 6)              \
+    X(6, 32, 6)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RNN_KERNEL_X86 1
+#define RNN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define RNN_KERNEL_X86 0
+#endif
+
+#define RNN_KERNEL_DEFINE_BASE(I, H, O) \
+    DEFINE_RNN_KERNEL(rnn_kernel_##I##_##H##_##O##_base, I, H, O, )
+RNN_KERNEL_SHAPES(RNN_KERNEL_DEFINE_BASE)
+
+#if RNN_KERNEL_X86
+#define RNN_KERNEL_DEFINE_AVX2(I, H, O) \
+    DEFINE_RNN_KERNEL(rnn_kernel_##I##_##H##_##O##_avx2, I, H, O, RNN_TARGET_AVX2)
+RNN_KERNEL_SHAPES(RNN_KERNEL_DEFINE_AVX2)
+#endif
+
+// REGISTRY
+// One entry per shape and instruction set, best instruction set first.
+typedef struct {
+    RnnShape shape;
+    const char *isa;
+    RnnKernel kernel;
+} RnnKernelEntry;
+
+#if RNN_KERNEL_X86
+#define RNN_KERNEL_ENTRIES(I, H, O)                           \
+    { { I, H, O }, "avx2", rnn_kernel_##I##_##H##_##O##_avx2 }, \
+    { { I, H, O }, "base", rnn_kernel_##I##_##H##_##O##_base },
+#else
+#define RNN_KERNEL_ENTRIES(I, H, O) \
+    { { I, H, O }, "base", rnn_kernel_##I##_##H##_##O##_base },
+#endif
+
+const RnnKernelEntry rnn_kernels[] = { RNN_KERNEL_SHAPES(RNN_KERNEL_ENTRIES) };
+
+#define RNN_KERNEL_COUNT ((int)(sizeof(rnn_kernels) / sizeof(rnn_kernels[0])))
+
+// can this CPU run kernels compiled for isa?
+int rnn_cpu_has(const char *isa)
+{
+    if (strcmp(isa, "base") == 0)
+        return 1;
+#if RNN_KERNEL_X86
+    if (strcmp(isa, "avx2") == 0)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    return 0;
+}
+
+/*
+ * rnn_pick_kernel
+ * The fastest kernel for this shape that the CPU can run, or
+ * rnn_step_generic() if the shape has none. name (may be NULL) receives
+ * the instruction set picked, "generic" for the fallback.
+ */
+RnnKernel rnn_pick_kernel(const RnnShape *shape, const char **name)
+{
+    for (int k = 0; k < RNN_KERNEL_COUNT; k++)
+    {
+        const RnnKernelEntry *e = &rnn_kernels[k];
+
+        if (e->shape.inputs == shape->inputs && e->shape.hidden == shape->hidden &&
+            e->shape.outputs == shape->outputs && rnn_cpu_has(e->isa))
+        {
+            if (name)
+                *name = e->isa;
+            return e->kernel;
+        }
+    }
+
+    if (name)
+        *name = "generic";
+    return rnn_step_generic;
+}
@@ -0,0 +1,461 @@
+#define RNN_GA_NO_MAIN
+#include "rnn_ga.c"
+
+#ifdef RECURRENT_DEGREE
+#error "rnn_quant.c works on dense networks only, build it without RECURRENT_DEGREE"
+#endif
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * INT8 INFERENCE FOR AN EVOLVED RNN
+ *
+ * The GA produces small, bounded weights: they start in [-1, 1] and only ever
+ * move by +-0.1 at a time. That makes them easy to squeeze into 8 bits.
+ *
+ * This tool:
+ *   1. Evolves a network with the normal GA (same as rnn_ga.c)
+ *   2. Quantizes every weight row to int8 with its own scale
+ *        real weight ~= int8 weight * row scale
+ *   3. Runs the network with int8 dot products and lookup-table tanh/sigmoid
+ *   4. Reports how much accuracy that costs on every task of the suite the
+ *      GA trains on (see TASK SUITE in rnn_ga.c), how fast it runs, and how
+ *      much memory one prediction session needs
+ *   5. Optionally writes the quantized network to a file (--export FILE)
+ *
+ * Activations are int8 too: a value v in [-1, 1] is stored as round(v * 127).
+ * Inputs and the bias are 0 or 1, hidden states come out of tanh, so
+ * everything the network feeds itself fits that range.
+ *
+ * Compile with your CPU's instruction set so the fast kernel is used:
+ *   gcc -O2 -march=native rnn_quant.c -lm -o rnn_quant
+ *   ./rnn_quant [--seed S] [--export rnn_int8.bin]
+ *
+ * --seed S evolves the same network again, so the accuracy numbers repeat.
+ */
+
+#define QPAD    32   // rows and state vectors are padded to one 256-bit register
+#define ACT_ONE 127  // int8 value that stands for an activation of 1.0
+
+#define PAD32(n)          (((n) + QPAD - 1) / QPAD * QPAD)
+#define QWIDTH(l)         PAD32(LAYER_WIDTH(l))
+#define QHIDDEN           PAD32(HIDDEN_NEURONS)
+#define QLAYER_OFFSET(l)  ((l) == 0 ? 0 : HIDDEN_NEURONS * QWIDTH(0) + ((l) - 1) * HIDDEN_NEURONS * QWIDTH(1))
+#define QOUTPUT_OFFSET    QLAYER_OFFSET(HIDDEN_LAYERS)
+#define QTOTAL            (QOUTPUT_OFFSET + OUTPUT_NEURONS * QHIDDEN)
+#define QROWS             (HIDDEN_LAYERS * HIDDEN_NEURONS + OUTPUT_NEURONS)
+#define QSTATE_OFFSET(l)  ((l) == 0 ? 0 : QWIDTH(0) + ((l) - 1) * QWIDTH(1))
+#define QSTATE_SIZE       QSTATE_OFFSET(HIDDEN_LAYERS)
+
+/*
+ * The quantized network.
+ * Same row order as the double weights (see WEIGHT LAYOUT in elmann_rnn.c),
+ * each row zero-padded to a multiple of 32 bytes.
+ * scale[r] turns row r's int8 weights back into real weights.
+ */
+typedef struct {
+    int8_t w[QTOTAL] __attribute__((aligned(QPAD)));
+    float  scale[QROWS];
+} QNet;
+
+/*
+ * One prediction session: everything a single user's sequence needs to carry
+ * from one step to the next. It is just the [x ; context] vectors, in int8.
+ * The weights are shared by every session.
+ */
+typedef struct {
+    int8_t z[QSTATE_SIZE] __attribute__((aligned(QPAD)));
+} QSession;
+
+/* The double version of a session, for comparison */
+typedef struct {
+    double z[STATE_SIZE];
+} DSession;
+
+/*
+ * LOOKUP TABLES
+ * tanh and sigmoid are flat outside [-8, 8], so a table over that range
+ * replaces the libm call. tanh goes straight to the int8 activation the
+ * next step needs, sigmoid to a float prediction.
+ */
+#define LUT_RANGE 8.0f
+#define LUT_SIZE  2048
+
+int8_t tanh_lut[LUT_SIZE + 1];
+float  sigmoid_lut[LUT_SIZE + 1];
+
+void init_luts()
+{
+    for (int i = 0; i <= LUT_SIZE; i++)
+    {
+        double x = -LUT_RANGE + i * (2.0 * LUT_RANGE / LUT_SIZE);
+        tanh_lut[i] = (int8_t)lrint(tanh(x) * ACT_ONE);
+        sigmoid_lut[i] = (float)sigmoid(x);
+    }
+}
+
+static inline int lut_index(float x)
+{
+    float f = (x + LUT_RANGE) * (LUT_SIZE / (2.0f * LUT_RANGE)) + 0.5f;
+    if (f < 0.0f) f = 0.0f;
+    if (f > LUT_SIZE) f = LUT_SIZE;
+    return (int)f;
+}
+
+/*
+ * INT8 DOT PRODUCT
+ * n is always a multiple of 32.
+ *
+ * The x86 instructions multiply an unsigned byte by a signed byte.
+ * Our activations are signed, so we move the sign over to the weight:
+ *   a * w == |a| * (w with a's sign)
+ * With both sides limited to +-127, a pair of products is at most
+ * 2 * 127 * 127 = 32258, which still fits the 16-bit lanes of maddubs.
+ */
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+#define DOT_KERNEL "avx512-vnni"
+#define DPBUSD(acc, a, b) _mm256_dpbusd_epi32(acc, a, b)
+#elif defined(__AVXVNNI__)
+#define DOT_KERNEL "avx-vnni"
+#define DPBUSD(acc, a, b) _mm256_dpbusd_avx_epi32(acc, a, b)
+#elif defined(__AVX2__)
+#define DOT_KERNEL "avx2 maddubs"
+#else
+#define DOT_KERNEL "scalar"
+#endif
+
+static inline int32_t dot_i8(const int8_t *a, const int8_t *w, int n)
+{
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+#ifndef DPBUSD
+    const __m256i ones = _mm256_set1_epi16(1);
+#endif
+    for (int j = 0; j < n; j += QPAD)
+    {
+        __m256i va = _mm256_load_si256((const __m256i *)(a + j));
+        __m256i vw = _mm256_load_si256((const __m256i *)(w + j));
+        __m256i ua = _mm256_sign_epi8(va, va);  // |a|
+        __m256i sw = _mm256_sign_epi8(vw, va);  // w with a's sign
+#ifdef DPBUSD
+        acc = DPBUSD(acc, ua, sw);
+#else
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(ua, sw), ones));
+#endif
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+#else
+    int32_t sum = 0;
+    for (int j = 0; j < n; j++)
+        sum += (int32_t)a[j] * w[j];
+    return sum;
+#endif
+}
+
+/*
+ * quantize
+ * Export step: turn the double weights of one gene into a QNet.
+ * Each row gets scale = (largest |weight| in the row) / 127, so the biggest
+ * weight maps to +-127 and nothing overflows.
+ */
+void quantize_row(const double *w, int n, int8_t *q, float *scale)
+{
+    double max = 0.0;
+    for (int j = 0; j < n; j++)
+        if (fabs(w[j]) > max) max = fabs(w[j]);
+
+    *scale = (max > 0.0) ? (float)(max / 127.0) : 1.0f;
+    for (int j = 0; j < n; j++)
+        q[j] = (int8_t)lrint(w[j] / *scale);
+}
+
+void quantize(const double *gene, QNet *q)
+{
+    int r = 0;
+    memset(q, 0, sizeof(*q));
+
+    for (int l = 0; l < HIDDEN_LAYERS; l++)
+        for (int i = 0; i < HIDDEN_NEURONS; i++, r++)
+            quantize_row(gene + LAYER_WEIGHT_OFFSET(l) + i * LAYER_WIDTH(l), LAYER_WIDTH(l),
+                         q->w + QLAYER_OFFSET(l) + i * QWIDTH(l), &q->scale[r]);
+
+    for (int i = 0; i < OUTPUT_NEURONS; i++, r++)
+        quantize_row(gene + OUTPUT_WEIGHT_OFFSET + i * HIDDEN_NEURONS, HIDDEN_NEURONS,
+                     q->w + QOUTPUT_OFFSET + i * QHIDDEN, &q->scale[r]);
+}
+
+/*
+ * Session handling for the int8 path.
+ * qsession_feed one-hot encodes a number into the first layer's x,
+ * exactly like the GA does with input[].
+ */
+void qsession_reset(QSession *s)
+{
+    memset(s->z, 0, sizeof(s->z));
+    for (int l = 1; l < HIDDEN_LAYERS; l++)
+        s->z[QSTATE_OFFSET(l)] = ACT_ONE;  // bias of the upper layers
+}
+
+void qsession_feed(QSession *s, int number)
+{
+    memset(s->z, 0, INPUT_NEURONS + 1);
+    s->z[0] = ACT_ONE;
+    s->z[number + 1] = ACT_ONE;
+}
+
+/*
+ * qstep
+ * The int8 version of RNN_step(): same layers, same order, but every dot
+ * product is int8 x int8 -> int32, and the activations come from the tables.
+ */
+void qstep(const QNet *q, QSession *s, float *out)
+{
+    int8_t h[QHIDDEN] __attribute__((aligned(QPAD))) = {0};
+    const float *scale = q->scale;
+
+    for (int l = 0; l < HIDDEN_LAYERS; l++, scale += HIDDEN_NEURONS)
+    {
+        int8_t *z = s->z + QSTATE_OFFSET(l);
+        const int8_t *w = q->w + QLAYER_OFFSET(l);
+
+        for (int i = 0; i < HIDDEN_NEURONS; i++)
+        {
+            int32_t acc = dot_i8(z, w + i * QWIDTH(l), QWIDTH(l));
+            h[i] = tanh_lut[lut_index(acc * scale[i] * (1.0f / ACT_ONE))];
+        }
+
+        memcpy(z + LAYER_INPUTS(l), h, HIDDEN_NEURONS);
+        if (l + 1 < HIDDEN_LAYERS)
+            memcpy(s->z + QSTATE_OFFSET(l + 1) + 1, h, HIDDEN_NEURONS);
+    }
+
+    for (int i = 0; i < OUTPUT_NEURONS; i++)
+    {
+        int32_t acc = dot_i8(h, q->w + QOUTPUT_OFFSET + i * QHIDDEN, QHIDDEN);
+        out[i] = sigmoid_lut[lut_index(acc * scale[i] * (1.0f / ACT_ONE))];
+    }
+}
+
+/* Session handling for the double path, same steps through RNN_step() */
+void dsession_feed(DSession *s, int number)
+{
+    for (int j = 0; j < INPUT_NEURONS + 1; j++) s->z[j] = 0.0;
+    s->z[0] = 1.0;
+    s->z[number + 1] = 1.0;
+}
+
+int argmax_f(const float *v)
+{
+    int best = 0;
+    for (int k = 1; k < OUTPUT_NEURONS; k++)
+        if (v[k] > v[best]) best = k;
+    return best;
+}
+
+int argmax_d(const double *v)
+{
+    int best = 0;
+    for (int k = 1; k < OUTPUT_NEURONS; k++)
+        if (v[k] > v[best]) best = k;
+    return best;
+}
+
+double seconds_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * export_qnet
+ * File format: "RNNQ", then INPUT, HIDDEN, LAYERS, OUTPUT as int32,
+ * then the QNet struct as it sits in memory.
+ */
+int export_qnet(const char *path, const QNet *q)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return 0;
+    }
+
+    int32_t dims[4] = {INPUT_NEURONS, HIDDEN_NEURONS, HIDDEN_LAYERS, OUTPUT_NEURONS};
+    int ok = fwrite("RNNQ", 1, 4, f) == 4 &&
+             fwrite(dims, sizeof(dims), 1, f) == 1 &&
+             fwrite(q, sizeof(*q), 1, f) == 1;
+
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "%s: write failed\n", path);
+    return ok;
+}
+
+#define SESSIONS 4096 // concurrent prediction sessions in the throughput test
+#define ROUNDS   100  // steps every session takes
+
+QNet qnet;
+QSession qsessions[SESSIONS];
+DSession dsessions[SESSIONS];
+
+int main(int argc, char **argv)
+{
+    const char *export_path = NULL;
+    uint64_t seed = time(NULL);
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--export") == 0 && a + 1 < argc)
+            export_path = argv[++a];
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc)
+            seed = strtoull(argv[++a], NULL, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [--seed S] [--export FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    init_luts();
+    RNN_init();
+    build_task_suite();
+    if (!alloc_population(POP_SIZE, 0))
+        return 1;
+    printf("Seed %llu\n", (unsigned long long)seed);
+
+    // 1. Evolve, exactly like rnn_ga.c
+    init_population(seed);
+    for (int gen = 0; gen < GENERATIONS; gen++)
+    {
+        evaluate_population();
+        reproduce(seed, gen);
+    }
+    evaluate_population();
+
+    int best = 0;
+    for (int i = 1; i < population.size; i++)
+        if (population.fitness[i] > population.fitness[best])
+            best = i;
+
+    // 2. Quantize
+    quantize(GENE(best), &qnet);
+    load_weights(GENE(best));
+
+    printf("Quantized best network (fitness %f) to int8, dot kernel: %s\n",
+           population.fitness[best], DOT_KERNEL);
+
+    // 3. Accuracy on every task of the suite, both paths side by side
+    double dtotal = 0.0, qtotal = 0.0, total_weight = 0.0, max_diff = 0.0;
+    int steps_all = 0, agree_all = 0;
+
+    printf("\nAccuracy on the task suite (fitness, correct predictions):\n");
+    printf("  %-14s %-16s %-16s %s\n", "task", "double", "int8", "agree");
+
+    for (int k = 0; k < task_count; k++)
+    {
+        const Task *task = &tasks[k];
+        DSession ds;
+        QSession qs;
+        double derr = 0.0, qerr = 0.0;
+        int dcorrect = 0, qcorrect = 0, agree = 0;
+
+        reset_state(ds.z);
+        qsession_reset(&qs);
+
+        for (int t = 0; t < task->length; t++)
+        {
+            double dout[OUTPUT_NEURONS], h[HIDDEN_NEURONS];
+            float qout[OUTPUT_NEURONS];
+
+            dsession_feed(&ds, task->input[t]);
+            RNN_step(weights, ds.z, h, dout);
+            qsession_feed(&qs, task->input[t]);
+            qstep(&qnet, &qs, qout);
+
+            for (int o = 0; o < OUTPUT_NEURONS; o++)
+            {
+                double expected = (o == task->target[t]) ? 1.0 : 0.0;
+                derr += (expected - dout[o]) * (expected - dout[o]);
+                qerr += (expected - qout[o]) * (expected - qout[o]);
+                if (fabs(dout[o] - qout[o]) > max_diff) max_diff = fabs(dout[o] - qout[o]);
+            }
+
+            dcorrect += argmax_d(dout) == task->target[t];
+            qcorrect += argmax_f(qout) == task->target[t];
+            agree += argmax_d(dout) == argmax_f(qout);
+        }
+
+        double dfit = 1.0 / (1.0 + derr), qfit = 1.0 / (1.0 + qerr);
+        printf("  %-14s %f %3d/%-3d %f %3d/%-3d %3d/%d\n", task->name,
+               dfit, dcorrect, task->length, qfit, qcorrect, task->length, agree, task->length);
+
+        dtotal += task->weight * dfit;
+        qtotal += task->weight * qfit;
+        total_weight += task->weight;
+        steps_all += task->length;
+        agree_all += agree;
+    }
+
+    printf("  weighted fitness: double %f, int8 %f, delta %+f\n",
+           dtotal / total_weight, qtotal / total_weight, (qtotal - dtotal) / total_weight);
+    printf("  predictions agree on %d / %d steps, max output difference %.4f\n",
+           agree_all, steps_all, max_diff);
+
+    // 4. Throughput: every session takes ROUNDS steps on its own number stream
+    double dsink = 0.0, qsink = 0.0;
+
+    for (int s = 0; s < SESSIONS; s++)
+    {
+        reset_state(dsessions[s].z);
+        qsession_reset(&qsessions[s]);
+    }
+
+    double t0 = seconds_now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int s = 0; s < SESSIONS; s++)
+        {
+            double dout[OUTPUT_NEURONS], h[HIDDEN_NEURONS];
+            dsession_feed(&dsessions[s], (s + r) % 3);
+            RNN_step(weights, dsessions[s].z, h, dout);
+            dsink += argmax_d(dout);
+        }
+    double t1 = seconds_now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int s = 0; s < SESSIONS; s++)
+        {
+            float qout[OUTPUT_NEURONS];
+            qsession_feed(&qsessions[s], (s + r) % 3);
+            qstep(&qnet, &qsessions[s], qout);
+            qsink += argmax_f(qout);
+        }
+    double t2 = seconds_now();
+
+    double steps = (double)SESSIONS * ROUNDS;
+    printf("\nThroughput, %d sessions x %d steps:\n", SESSIONS, ROUNDS);
+    printf("  double: %.2f M steps/s (%.1f ns/step)\n", steps / (t1 - t0) / 1e6, (t1 - t0) / steps * 1e9);
+    printf("  int8:   %.2f M steps/s (%.1f ns/step), %.2fx\n",
+           steps / (t2 - t1) / 1e6, (t2 - t1) / steps * 1e9, (t1 - t0) / (t2 - t1));
+    printf("  (predicted-class checksums %.0f / %.0f)\n", dsink, qsink);
+
+    printf("\nMemory:\n");
+    printf("  per session: double %zu bytes, int8 %zu bytes\n", sizeof(DSession), sizeof(QSession));
+    printf("  shared weights: double %zu bytes, int8 %zu bytes (with scales)\n",
+           sizeof(double) * TOTAL_WEIGHTS, sizeof(QNet));
+
+    // 5. Export
+    if (export_path)
+    {
+        if (!export_qnet(export_path, &qnet))
+            return 1;
+        printf("\nWrote %s\n", export_path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,614 @@
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "rng.c"
+
+/*
+ * HYPERPARAMETER SWEEP
+ *
+ * Runs many GA configurations side by side and drops the bad ones early.
+ *
+ *   gcc -O2 rnn_sweep.c -lm -o rnn_sweep
+ *   ./rnn_sweep --hidden 4,8,16 --pop 50,200 --mutation-rate 0.02,0.05,0.1
+ *   ./rnn_sweep --random 40 --hidden 4:32 --mutation-rate 0.005:0.2 --target 0.2
+ *
+ * Every value list is either a comma list ("4,8,16") or, with --random, a
+ * range ("4:32"). Without --random every combination is tried (a grid).
+ * With --random N, N configurations are drawn: one value from each list, or
+ * one value from each range, spread evenly on a log scale, so 0.005:0.2 is
+ * as likely to give 0.005-0.03 as 0.03-0.2.
+ *
+ * The hidden size is compiled into the network, so rnn_ga.c is built once
+ * per hidden size (into --build-dir). Population, mutation rate and mutation
+ * size are rnn_ga options, so one binary serves all of those.
+ *
+ * SUCCESSIVE HALVING
+ * Every configuration first runs --min-gens generations. Then they are
+ * ranked by the best fitness they have reached, the best 1 in --eta keep
+ * going until eta times as many generations, and so on until the survivors
+ * reach --generations. With 27 configurations and eta 3, 9 go on from 5 to
+ * 15 generations, 3 to 45, 1 to 135: about a fifth of the generations a
+ * full grid would cost.
+ *
+ * Each run is one rnn_ga process on one thread, --jobs of them at a time
+ * (default: one per CPU). They run with --stdin-budget: rnn_ga stops when it
+ * has done the generations it was given and waits for a new total on stdin.
+ * So a configuration that survives a round continues where it left off
+ * instead of starting over, and a pruned one is simply killed. Waiting
+ * processes cost memory, not CPU.
+ *
+ * All runs share one --seed, so configurations are compared on the same
+ * first generation and the same random numbers wherever they can be.
+ *
+ * With --target F the table also shows, for each configuration, after how
+ * many generations and how many seconds of running (waits not counted)
+ * its best fitness first reached F.
+ */
+
+#define MAX_VALUES 64
+#define LINE_MAX_LEN 512
+
+// one swept parameter: a list of values, or with --random a range lo:hi
+typedef struct {
+    const char *name;
+    double values[MAX_VALUES];
+    int count;
+    int is_range;
+} Param;
+
+enum { HIDDEN, POP, RATE, SIZE, PARAM_COUNT };
+
+Param params[PARAM_COUNT] = {
+    { "--hidden",        { 8 },    1, 0 },
+    { "--pop",           { 50 },   1, 0 },
+    { "--mutation-rate", { 0.05 }, 1, 0 },
+    { "--mutation-size", { 0.1 },  1, 0 },
+};
+
+enum { QUEUED, RUNNING, WAITING, FINISHED, PRUNED, FAILED };
+
+const char *status_names[] = { "queued", "running", "waiting", "finished", "pruned", "failed" };
+
+typedef struct {
+    double value[PARAM_COUNT];
+    int status;
+
+    pid_t pid;
+    int to_child;          // its stdin, where budgets are written
+    int from_child;        // its stdout, read line by line
+    char line[LINE_MAX_LEN];
+    int line_len;
+
+    int budget;            // generations it may run in total
+    int gens;              // generations it has reported
+    double best;           // best fitness reported so far
+    double active;         // seconds spent running, waits not counted
+    double resumed_at;
+
+    int pruned_at;         // generation it was stopped at
+    int target_gen;        // -1 until best reaches the target
+    double target_seconds;
+} Trial;
+
+Trial *trials;
+int trial_count;
+
+int generations = 100, min_gens = 5, eta = 3, jobs = 0;
+double target = -1.0;
+unsigned long long seed = 1;
+const char *source = "rnn_ga.c";
+const char *build_dir = "sweep_build";
+
+double seconds_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* "4,8,16" or "0.01:0.2" into p. Returns 0 if it does not parse or is empty. */
+int parse_param(Param *p, const char *s)
+{
+    char *end = (char *)s;
+
+    p->count = 0;
+    p->is_range = strchr(s, ':') != NULL;
+    while (*s && p->count < MAX_VALUES)
+    {
+        p->values[p->count++] = strtod(s, &end);
+        if (end == s)
+            return 0;
+        if (*end != ',' && *end != ':')
+            break;
+        s = end + 1;
+    }
+    if (p->count == 0 || *end != 0)
+        return 0;
+    if (p->is_range && (p->count != 2 || p->values[0] <= 0 || p->values[1] < p->values[0]))
+        return 0;
+    return 1;
+}
+
+// value of parameter p for the random configuration drawn from r
+double draw(const Param *p, Rng *r)
+{
+    if (!p->is_range)
+        return p->values[(int)(rng_uniform(r) * p->count)];
+
+    double lo = log(p->values[0]), hi = log(p->values[1]);
+    return exp(lo + rng_uniform(r) * (hi - lo));
+}
+
+/*
+ * make_trials
+ * The grid walks every combination like an odometer, the last parameter
+ * turning fastest. Integer parameters drawn from a range are rounded.
+ */
+void make_trials(int random_count)
+{
+    if (random_count > 0)
+    {
+        trial_count = random_count;
+        trials = calloc(trial_count, sizeof(Trial));
+        for (int t = 0; t < trial_count; t++)
+        {
+            Rng r = rng_stream(seed, 0x5eed, t);
+            for (int p = 0; p < PARAM_COUNT; p++)
+                trials[t].value[p] = draw(&params[p], &r);
+            trials[t].value[HIDDEN] = round(trials[t].value[HIDDEN]);
+            trials[t].value[POP] = round(trials[t].value[POP]);
+        }
+        return;
+    }
+
+    trial_count = 1;
+    for (int p = 0; p < PARAM_COUNT; p++)
+        trial_count *= params[p].count;
+    trials = calloc(trial_count, sizeof(Trial));
+
+    for (int t = 0; t < trial_count; t++)
+    {
+        int rest = t;
+        for (int p = PARAM_COUNT - 1; p >= 0; p--)
+        {
+            trials[t].value[p] = params[p].values[rest % params[p].count];
+            rest /= params[p].count;
+        }
+    }
+}
+
+void binary_path(char *out, size_t size, int hidden)
+{
+    snprintf(out, size, "%s/rnn_ga_h%d", build_dir, hidden);
+}
+
+/*
+ * build_binaries
+ * One compile per distinct hidden size. The compiler is run from an argument
+ * list, not through the shell, so paths with spaces in them are fine.
+ */
+int build_binaries()
+{
+    const char *cc = getenv("CC") ? getenv("CC") : "cc";
+
+    if (mkdir(build_dir, 0755) != 0 && errno != EEXIST)
+    {
+        perror(build_dir);
+        return 0;
+    }
+
+    for (int t = 0; t < trial_count; t++)
+    {
+        int hidden = (int)trials[t].value[HIDDEN], seen = 0;
+        for (int u = 0; u < t; u++)
+            seen |= (int)trials[u].value[HIDDEN] == hidden;
+        if (seen)
+            continue;
+
+        char define[64], out[1024];
+        snprintf(define, sizeof(define), "-DHIDDEN_NEURONS=%d", hidden);
+        binary_path(out, sizeof(out), hidden);
+        printf("Building %s\n", out);
+        fflush(stdout);
+
+        char *argv[] = { (char *)cc, "-O2", "-march=native", define, (char *)source,
+                         "-o", out, "-lm", "-pthread", NULL };
+        int status;
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            execvp(cc, argv);
+            perror(cc);
+            _exit(127);
+        }
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "could not build %s\n", out);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void end_trial(Trial *t, int status);
+
+// tell a started run how many generations it may do in total
+void give_budget(Trial *t, int budget)
+{
+    char msg[32];
+    int n = snprintf(msg, sizeof(msg), "%d\n", budget);
+
+    t->budget = budget;
+    t->status = RUNNING;
+    t->resumed_at = seconds_now();
+    if (write(t->to_child, msg, n) != n)
+        end_trial(t, FAILED);
+}
+
+/* Fork rnn_ga for trial t with its stdin and stdout on pipes. */
+int start_trial(Trial *t, int budget)
+{
+    char binary[1024], seed_s[32], pop_s[32], rate_s[32], size_s[32], gens_s[32];
+    int in[2], out[2];
+
+    binary_path(binary, sizeof(binary), (int)t->value[HIDDEN]);
+    snprintf(seed_s, sizeof(seed_s), "%llu", seed);
+    snprintf(pop_s, sizeof(pop_s), "%d", (int)t->value[POP]);
+    snprintf(rate_s, sizeof(rate_s), "%.17g", t->value[RATE]);
+    snprintf(size_s, sizeof(size_s), "%.17g", t->value[SIZE]);
+    snprintf(gens_s, sizeof(gens_s), "%d", generations);
+
+    char *argv[] = { binary, "--threads", "1", "--stdin-budget", "--seed", seed_s, "--pop", pop_s,
+                     "--mutation-rate", rate_s, "--mutation-size", size_s, "--generations", gens_s, NULL };
+
+    if (pipe(in) != 0)
+        return 0;
+    if (pipe(out) != 0)
+    {
+        close(in[0]);
+        close(in[1]);
+        return 0;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+        return 0;
+    }
+    if (pid == 0)
+    {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        // the other runs' pipes were inherited too; close them all
+        for (int fd = 3; fd < 1024; fd++)
+            close(fd);
+        execv(binary, argv);
+        perror(binary);
+        _exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+    t->pid = pid;
+    t->to_child = in[1];
+    t->from_child = out[0];
+    t->best = -1.0;
+    t->target_gen = -1;
+    give_budget(t, budget);
+    return 1;
+}
+
+// stop counting this run's time: it is waiting or gone
+void pause_clock(Trial *t)
+{
+    t->active += seconds_now() - t->resumed_at;
+}
+
+void end_trial(Trial *t, int status)
+{
+    if (t->status == RUNNING)
+        pause_clock(t);
+    if (t->pid > 0)
+    {
+        kill(t->pid, SIGKILL);
+        waitpid(t->pid, NULL, 0);
+        close(t->to_child);
+        close(t->from_child);
+        t->pid = 0;
+    }
+    t->status = status;
+}
+
+/*
+ * handle_line
+ * rnn_ga prints "Generation g complete (best f)" after every generation and
+ * "Waiting at generation g" once it has used up its budget.
+ */
+void handle_line(Trial *t, const char *line)
+{
+    int gen;
+    double best;
+
+    if (sscanf(line, "Generation %d complete (best %lf)", &gen, &best) == 2)
+    {
+        t->gens = gen + 1;
+        if (best > t->best)
+            t->best = best;
+        if (target >= 0 && t->target_gen < 0 && t->best >= target)
+        {
+            t->target_gen = t->gens;
+            t->target_seconds = t->active + seconds_now() - t->resumed_at;
+        }
+    }
+    else if (sscanf(line, "Best fitness: %lf", &best) == 1)
+    {
+        if (best > t->best)
+            t->best = best;
+    }
+    else if (sscanf(line, "Waiting at generation %d", &gen) == 1 && gen >= t->budget)
+    {
+        // (a new run asks once at generation 0, before it reads the budget already sent)
+        pause_clock(t);
+        t->status = WAITING;
+    }
+}
+
+// read what t printed; at end of output the run has finished (or crashed)
+void read_trial(Trial *t)
+{
+    char buf[4096];
+    ssize_t n = read(t->from_child, buf, sizeof(buf));
+
+    if (n < 0 && errno == EINTR)
+        return;
+    if (n <= 0)
+    {
+        int status = 0;
+        waitpid(t->pid, &status, 0);
+        close(t->to_child);
+        close(t->from_child);
+        t->pid = 0;
+        pause_clock(t);
+        t->status = WIFEXITED(status) && WEXITSTATUS(status) == 0 ? FINISHED : FAILED;
+        return;
+    }
+
+    for (ssize_t k = 0; k < n; k++)
+    {
+        if (buf[k] == '\n' || t->line_len == LINE_MAX_LEN - 1)
+        {
+            t->line[t->line_len] = 0;
+            handle_line(t, t->line);
+            t->line_len = 0;
+        }
+        else
+            t->line[t->line_len++] = buf[k];
+    }
+}
+
+/*
+ * run_rung
+ * Bring every live run up to budget generations, never more than jobs of
+ * them running at once.
+ */
+void run_rung(int budget)
+{
+    for (;;)
+    {
+        int running = 0;
+        for (int t = 0; t < trial_count; t++)
+            running += trials[t].status == RUNNING;
+
+        for (int t = 0; t < trial_count && running < jobs; t++)
+        {
+            Trial *tr = &trials[t];
+            if (tr->status == QUEUED)
+            {
+                if (start_trial(tr, budget))
+                    running++;
+                else
+                    tr->status = FAILED;
+            }
+            else if (tr->status == WAITING && tr->gens < budget)
+            {
+                give_budget(tr, budget);
+                running++;
+            }
+        }
+
+        if (running == 0)
+            return;
+
+        struct pollfd fds[jobs];
+        Trial *owner[jobs];
+        int n = 0;
+        for (int t = 0; t < trial_count && n < jobs; t++)
+            if (trials[t].status == RUNNING)
+            {
+                fds[n] = (struct pollfd){ .fd = trials[t].from_child, .events = POLLIN };
+                owner[n++] = &trials[t];
+            }
+
+        if (poll(fds, n, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            exit(1);
+        }
+        for (int k = 0; k < n; k++)
+            if (fds[k].revents)
+                read_trial(owner[k]);
+    }
+}
+
+// best first; runs that failed or never reported sort last
+int by_best(const void *a, const void *b)
+{
+    const Trial *x = *(Trial *const *)a, *y = *(Trial *const *)b;
+    if (x->best != y->best)
+        return x->best > y->best ? -1 : 1;
+    return x < y ? -1 : 1;
+}
+
+/*
+ * successive_halving
+ * Rungs at min_gens, min_gens * eta, min_gens * eta^2, ... and finally
+ * generations. After each rung below the last, only the best
+ * ceil(live / eta) runs are kept.
+ */
+void successive_halving()
+{
+    Trial **order = malloc(trial_count * sizeof(Trial *));
+    long budget = min_gens < generations ? min_gens : generations;
+
+    for (;;)
+    {
+        printf("Rung: %ld generations\n", budget);
+        fflush(stdout);
+        run_rung((int)budget);
+
+        int live = 0;
+        for (int t = 0; t < trial_count; t++)
+            if (trials[t].status == WAITING || trials[t].status == RUNNING)
+                order[live++] = &trials[t];
+
+        if (budget >= generations || live == 0)
+            break;
+
+        qsort(order, live, sizeof(Trial *), by_best);
+        int keep = (live + eta - 1) / eta;
+        for (int k = keep; k < live; k++)
+        {
+            order[k]->pruned_at = order[k]->gens;
+            end_trial(order[k], PRUNED);
+        }
+
+        budget *= eta;
+        if (budget > generations)
+            budget = generations;
+    }
+    free(order);
+}
+
+void print_report()
+{
+    Trial **order = malloc(trial_count * sizeof(Trial *));
+    for (int t = 0; t < trial_count; t++)
+        order[t] = &trials[t];
+    qsort(order, trial_count, sizeof(Trial *), by_best);
+
+    printf("\n%6s %7s %10s %10s  %-14s %9s  %s\n",
+           "hidden", "pop", "mut rate", "mut size", "status", "best", "to target");
+    for (int k = 0; k < trial_count; k++)
+    {
+        Trial *t = order[k];
+        char status[32], reached[64] = "-";
+
+        if (t->status == PRUNED)
+            snprintf(status, sizeof(status), "pruned at %d", t->pruned_at);
+        else
+            snprintf(status, sizeof(status), "%s", status_names[t->status]);
+        if (t->target_gen >= 0)
+            snprintf(reached, sizeof(reached), "%d gens, %.2f s", t->target_gen, t->target_seconds);
+
+        printf("%6d %7d %10.4g %10.4g  %-14s %9.6f  %s\n",
+               (int)t->value[HIDDEN], (int)t->value[POP], t->value[RATE], t->value[SIZE],
+               status, t->best, reached);
+    }
+    free(order);
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [--hidden LIST] [--pop LIST] [--mutation-rate LIST] [--mutation-size LIST]\n"
+                    "          [--random N] [--generations N] [--min-gens N] [--eta N] [--target F]\n"
+                    "          [--jobs N] [--seed S] [--source rnn_ga.c] [--build-dir DIR]\n"
+                    "  LIST is a,b,c or, with --random, lo:hi\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    int random_count = 0;
+
+    for (int a = 1; a < argc; a++)
+    {
+        int p;
+        for (p = 0; p < PARAM_COUNT; p++)
+            if (strcmp(argv[a], params[p].name) == 0)
+                break;
+
+        if (p < PARAM_COUNT && a + 1 < argc)
+        {
+            if (!parse_param(&params[p], argv[++a]))
+            {
+                if (*argv[a] == 0)
+                    fprintf(stderr, "%s: needs at least one value\n", params[p].name);
+                else
+                    fprintf(stderr, "%s: cannot read %s\n", params[p].name, argv[a]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[a], "--random") == 0 && a + 1 < argc) random_count = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--generations") == 0 && a + 1 < argc) generations = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--min-gens") == 0 && a + 1 < argc) min_gens = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--eta") == 0 && a + 1 < argc) eta = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--target") == 0 && a + 1 < argc) target = atof(argv[++a]);
+        else if (strcmp(argv[a], "--jobs") == 0 && a + 1 < argc) jobs = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) seed = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--source") == 0 && a + 1 < argc) source = argv[++a];
+        else if (strcmp(argv[a], "--build-dir") == 0 && a + 1 < argc) build_dir = argv[++a];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    for (int p = 0; p < PARAM_COUNT; p++)
+        if (params[p].is_range && random_count <= 0)
+        {
+            fprintf(stderr, "%s: ranges need --random N\n", params[p].name);
+            return 1;
+        }
+    if (generations < 1 || min_gens < 1 || eta < 2)
+    {
+        fprintf(stderr, "need --generations >= 1, --min-gens >= 1, --eta >= 2\n");
+        return 1;
+    }
+    if (jobs <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // a run that crashed shows up as a failed write, not a crash here
+
+    make_trials(random_count);
+    for (int t = 0; t < trial_count; t++)
+        if (trials[t].value[HIDDEN] < 1 || trials[t].value[POP] < 2)
+        {
+            fprintf(stderr, "hidden sizes must be >= 1 and populations >= 2\n");
+            return 1;
+        }
+
+    if (!build_binaries())
+        return 1;
+
+    printf("%d configurations, %d at a time, seed %llu\n", trial_count, jobs, seed);
+    double start = seconds_now();
+    successive_halving();
+
+    print_report();
+    printf("\nSweep took %.1f s\n", seconds_now() - start);
+    return 0;
+}
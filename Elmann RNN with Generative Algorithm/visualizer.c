@@ -1,3 +1,6 @@
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64 /* history files past 2 GiB on 32-bit systems, see history.c */
+#endif
 #include "raylib.h"
 #include <math.h>
 #include <stdio.h>
@@ -5,7 +8,18 @@
 #include <time.h>
 #include <string.h>
 
+/* Size the network's arrays for the largest hidden layer the [ ] keys allow.
+   The visualizer draws a single hidden layer. */
+#define MIN_HIDDEN 2
+#ifndef MAX_HIDDEN
+#define MAX_HIDDEN 12   /* raise with -DMAX_HIDDEN=256 to inspect bigger networks */
+#endif
+#define HIDDEN_NEURONS MAX_HIDDEN
+#define HIDDEN_LAYERS  1
+
 #include "elmann_rnn.c"
+#include "rng.c"
+#include "history.c"
 
 /*
  * visualizer.c
@@ -23,10 +37,18 @@
  *   hover a node   tooltip showing what it does and its current value
  *   type 0, 1, 2   while paused: feed that number in manually and watch
  *
+ * Replaying a run recorded with rnn_ga --history FILE:
+ *   LEFT RIGHT     one generation back or forward (hold SHIFT for 100)
+ *   PGUP PGDN      1% of the run back or forward
+ *   HOME END       first or last generation
+ *   click graph    jump to that generation (drag to scrub)
+ *   SPACE          play forward
+ *
  * Compile (Mac):
  *   gcc visualizer.c -I/opt/homebrew/include -L/opt/homebrew/lib -lraylib -lm -o visualizer
  * Run:
- *   ./visualizer
+ *   ./visualizer            evolve a network live
+ *   ./visualizer run.hist   replay a recorded run
  */
 
 #define POP_SIZE      50
@@ -36,10 +58,14 @@
 #define SW 1440
 #define SH  860
 
-#define MIN_HIDDEN 2
-#define MAX_HIDDEN 12
+int h_count = 8;
 
-int h_count = HIDDEN_NEURONS;
+/* Weights in the row-fused layout of elmann_rnn.c, for the current h_count:
+   each hidden row is [input weights ; recurrent weights], then the output rows. */
+#define ROW_W     (INPUT_NEURONS+1+h_count)
+#define W_IH(i,j) weights[(i)*ROW_W+(j)]
+#define W_HH(i,j) weights[(i)*ROW_W+INPUT_NEURONS+1+(j)]
+#define W_HO(i,j) weights[h_count*ROW_W+(i)*h_count+(j)]
 
 typedef struct {
     double gene[TOTAL_WEIGHTS];
@@ -49,33 +75,30 @@ typedef struct {
 Chromosome population[POP_SIZE];
 Chromosome new_population[POP_SIZE];
 
+/* rand() costs more than the rest of a generation once a network has a few
+   hundred hidden neurons (two or three draws per weight), so the GA draws
+   from one rng.c stream, seeded from the clock in main(). */
+Rng ga_rng;
+
 void init_population()
 {
     int total = h_count*(INPUT_NEURONS+1) + h_count*h_count + OUTPUT_NEURONS*h_count;
     for (int i = 0; i < POP_SIZE; i++) {
         for (int j = 0; j < total; j++)
-            population[i].gene[j] = ((double)rand()/RAND_MAX)*2.0-1.0;
+            population[i].gene[j] = rng_uniform(&ga_rng)*2.0-1.0;
         population[i].fitness = 0.0;
     }
 }
 
 void load_weights(double *gene)
 {
-    int k = 0;
-    for (int i = 0; i < h_count; i++)
-        for (int j = 0; j < INPUT_NEURONS+1; j++)
-            w_input_hidden[i][j] = gene[k++];
-    for (int i = 0; i < h_count; i++)
-        for (int j = 0; j < h_count; j++)
-            w_hidden_hidden[i][j] = gene[k++];
-    for (int i = 0; i < OUTPUT_NEURONS; i++)
-        for (int j = 0; j < h_count; j++)
-            w_hidden_output[i][j] = gene[k++];
+    int total = h_count*(INPUT_NEURONS+1) + h_count*h_count + OUTPUT_NEURONS*h_count;
+    memcpy(weights, gene, total*sizeof(double));
 }
 
 int select_parent()
 {
-    int a = rand()%POP_SIZE, b = rand()%POP_SIZE;
+    int a = rng_next(&ga_rng)%POP_SIZE, b = rng_next(&ga_rng)%POP_SIZE;
     return (population[a].fitness > population[b].fitness) ? a : b;
 }
 
@@ -85,30 +108,31 @@ void reproduce()
     for (int i = 0; i < POP_SIZE; i++) {
         int p1 = select_parent(), p2 = select_parent();
         for (int j = 0; j < total; j++) {
-            new_population[i].gene[j] = (rand()%2) ?
+            new_population[i].gene[j] = (rng_next(&ga_rng)>>63) ?
                 population[p1].gene[j] : population[p2].gene[j];
-            if (((double)rand()/RAND_MAX) < MUTATION_RATE)
-                new_population[i].gene[j] += ((double)rand()/RAND_MAX)*0.2-0.1;
+            if (rng_uniform(&ga_rng) < MUTATION_RATE)
+                new_population[i].gene[j] += rng_uniform(&ga_rng)*0.2-0.1;
         }
         new_population[i].fitness = 0.0;
     }
     for (int i = 0; i < POP_SIZE; i++) population[i] = new_population[i];
 }
 
+/* Step kernel for the current h_count, picked again whenever [ ] changes it.
+   Sizes rnn_kernels.c has no kernel for use the generic step. */
+RnnShape step_shape;
+RnnKernel step_kernel;
+const char *step_isa = "generic";
+
 void feed_forward_rt()
 {
-    for (int i = 0; i < h_count; i++) {
-        double s = 0.0;
-        for (int j = 0; j < INPUT_NEURONS+1; j++) s += w_input_hidden[i][j]*input[j];
-        for (int j = 0; j < h_count; j++)         s += w_hidden_hidden[i][j]*context[j];
-        hidden[i] = tanh(s);
-    }
-    for (int i = 0; i < OUTPUT_NEURONS; i++) {
-        double s = 0.0;
-        for (int j = 0; j < h_count; j++) s += w_hidden_output[i][j]*hidden[j];
-        outputs[i] = 1.0/(1.0+exp(-s));
-    }
-    for (int i = 0; i < h_count; i++) context[i] = hidden[i];
+    if (step_shape.hidden != h_count) {
+        step_shape = (RnnShape){INPUT_NEURONS, h_count, OUTPUT_NEURONS};
+        step_kernel = rnn_pick_kernel(&step_shape, &step_isa);
+    }
+    /* input[] and context[] are contiguous, so state is the kernel's z = [x ; context];
+       the kernel copies hidden[] into context[] itself */
+    step_kernel(&step_shape, weights, input, hidden, outputs);
 }
 
 void reset_ctx() { for (int i = 0; i < h_count; i++) context[i] = 0.0; }
@@ -184,6 +208,12 @@ int show_ctx = 1;
 #define PNW 680
 #define PNH 280
 
+/* plot area inside the fitness panel */
+#define GX (RX+40)
+#define GY (RY+48)
+#define GW (RW-52)
+#define GH (RH-68)
+
 #define IFX 740
 #define IFY 660
 #define IFW 680
@@ -199,8 +229,20 @@ float hid_act[MAX_HIDDEN];
 float out_act[OUTPUT_NEURONS];
 float ctx_act[MAX_HIDDEN];
 
-float fit_history[GENERATIONS+2];
-int   fit_count = 0;
+/* best fitness of every generation so far, grows as needed */
+float *fit_history = NULL;
+int   fit_count = 0, fit_cap = 0;
+
+void add_fitness(float f)
+{
+    if(fit_count==fit_cap){
+        int cap = fit_cap ? 2*fit_cap : GENERATIONS+2;
+        float *bigger = realloc(fit_history, cap*sizeof(float));
+        if(!bigger) return;   /* out of memory: the graph stops growing, evolution goes on */
+        fit_history = bigger; fit_cap = cap;
+    }
+    fit_history[fit_count++] = f;
+}
 
 int current_gen = 0;
 int paused      = 1;
@@ -217,6 +259,33 @@ const char *speed_labels[] = {"Slow","Medium","Fast"};
 
 int manual_input = -1;
 
+/*
+ * Replay mode (./visualizer run.hist).
+ * Shows the best network of any generation of a recorded run. Only the
+ * generation on screen is read from the file (see history.c), so jumping
+ * around a run of millions of generations is instant. The curve comes from
+ * the file's index and is read once.
+ */
+#define CURVE_POINTS 640
+History replay;
+int replaying = 0;
+int replay_gen = 0;
+HistoryStats replay_stats;
+float replay_curve[CURVE_POINTS];
+int replay_points = 0;
+
+/*
+ * Cached network layer.
+ * The panel, the legend and every weight line only change when the weights,
+ * the selection or the layout change, at most once per generation. They are
+ * drawn once into edge_cache, and every frame just pastes that texture and
+ * draws the nodes on top. Set edges_dirty to have it redrawn.
+ */
+#define CACHE_W (NX+NW+8)  /* up to the hidden state panel */
+#define CACHE_H (SH-28)    /* down to the status bar */
+RenderTexture2D edge_cache;
+int edges_dirty = 1;
+
 void recalc_layout()
 {
     COL_I = NX+55; COL_H = NX+NW/2; COL_O = NX+NW-55;
@@ -238,6 +307,7 @@ void recalc_layout()
         ctx_pos[i].x=CTX_X+CTX_W/2;
         ctx_pos[i].y=NY+60+i*(float)(NH-100)/(h_count>1?h_count-1:1);
     }
+    edges_dirty=1;
 }
 
 Color wcolor(double w, unsigned char a)
@@ -294,9 +364,38 @@ void run_demo(int best)
     }
     update_activations();
     demo_ready=1;
+    edges_dirty=1;
 }
 
-void draw_network()
+void show_replay_gen(int gen)
+{
+    if(gen>replay.gens-1) gen=replay.gens-1;
+    if(gen<0) gen=0;
+    if(!history_read(&replay,gen,&replay_stats,population[0].gene,NULL)) return;
+    replay_gen=current_gen=gen;
+    run_demo(0);
+}
+
+/* Open a history file; the network drawn takes its hidden size. */
+int open_replay(const char *path)
+{
+    if(!history_open(&replay,path)) return 0;
+    HistoryHeader *hd=&replay.head;
+    if(hd->inputs!=INPUT_NEURONS||hd->outputs!=OUTPUT_NEURONS||hd->layers!=1||hd->connections!=0||
+       (int)hd->hidden<MIN_HIDDEN||(int)hd->hidden>MAX_HIDDEN){
+        fprintf(stderr,"%s: the visualizer shows dense networks with one hidden layer of %d to %d neurons\n"
+                       "(this one has %u layer(s) of %u; raise MAX_HIDDEN with -DMAX_HIDDEN=N)\n",
+                path,MIN_HIDDEN,MAX_HIDDEN,hd->layers,hd->hidden);
+        return 0;
+    }
+    if(replay.gens==0){ fprintf(stderr,"%s: no generations recorded\n",path); return 0; }
+    h_count=(int)hd->hidden;
+    replay_points=history_curve(&replay,replay_curve,CURVE_POINTS);
+    replaying=1;
+    return 1;
+}
+
+void draw_edges()
 {
     draw_panel(NX,NY,NW,NH,"NETWORK  (hover a node to learn about it, click to inspect connections)");
     DrawText("INPUT", COL_I-18,NY+30,11,C_GRAY);
@@ -306,24 +405,65 @@ void draw_network()
 
     for(int i=0;i<h_count;i++)
         for(int j=0;j<n;j++){
-            double w=w_input_hidden[i][j];
+            double w=W_IH(i,j);
             int hi=(sel_layer==0&&sel_idx==j)||(sel_layer==1&&sel_idx==i);
             DrawLineEx(inp_pos[j],hid_pos[i],hi?wthick(w)+1:0.6f,wcolor(w,hi?200:25));
         }
     for(int i=0;i<OUTPUT_NEURONS;i++)
         for(int j=0;j<h_count;j++){
-            double w=w_hidden_output[i][j];
+            double w=W_HO(i,j);
             int hi=(sel_layer==1&&sel_idx==j)||(sel_layer==2&&sel_idx==i);
             DrawLineEx(hid_pos[j],out_pos[i],hi?wthick(w)+1:0.6f,wcolor(w,hi?200:25));
         }
-    for(int i=0;i<h_count;i++)
-        for(int j=0;j<h_count;j++){
-            if(i==j) continue;
-            double w=w_hidden_hidden[i][j];
-            int hi=(sel_layer==1&&(sel_idx==i||sel_idx==j));
-            DrawLineBezier(hid_pos[j],hid_pos[i],hi?1.6f:0.3f,wcolor(w,hi?140:12));
+    /* The recurrent curves run along the hidden column, under the nodes. Once
+       the nodes overlap (from about 24 neurons) they hide every curve, and
+       drawing h_count^2 of them would only slow down each redraw. */
+    float spacing=(float)(NH-100)/(h_count>1?h_count-1:1);
+    if(spacing>2*NR)
+        for(int i=0;i<h_count;i++)
+            for(int j=0;j<h_count;j++){
+                if(i==j) continue;
+                double w=W_HH(i,j);
+                int hi=(sel_layer==1&&(sel_idx==i||sel_idx==j));
+                DrawLineBezier(hid_pos[j],hid_pos[i],hi?1.6f:0.3f,wcolor(w,hi?140:12));
+            }
+
+    if(show_ctx)
+        for(int i=0;i<h_count;i++){
+            Vector2 tip={hid_pos[i].x+NR+1,hid_pos[i].y};
+            Vector2 end={(float)CTX_X-2,ctx_pos[i].y};
+            DrawLineEx(tip,end,0.5f,Fade(C_CTX,0.18f));
         }
 
+    /* Legend */
+    int lx=NX+8,ly=NY+NH+2;
+    DrawRectangle(lx,     ly,10,7,(Color){220,55,55,200}); DrawText("positive weight",lx+13,ly-1,9,C_GRAY);
+    DrawRectangle(lx+140, ly,10,7,(Color){55,55,220,200}); DrawText("negative weight",lx+153,ly-1,9,C_GRAY);
+    DrawText("brightest output = prediction",lx+290,ly-1,9,C_GRAY);
+}
+
+/* Redraw edge_cache if something it shows has changed. Call outside BeginDrawing. */
+void refresh_edge_cache()
+{
+    if(!edges_dirty) return;
+    Vector2 dpi=GetWindowScaleDPI();
+    BeginTextureMode(edge_cache);
+    ClearBackground(C_BG);
+    BeginMode2D((Camera2D){.zoom=dpi.x});
+    draw_edges();
+    EndMode2D();
+    EndTextureMode();
+    edges_dirty=0;
+}
+
+void draw_network()
+{
+    /* render textures are stored upside down, hence the negative height */
+    Texture2D t=edge_cache.texture;
+    DrawTexturePro(t,(Rectangle){0,0,(float)t.width,-(float)t.height},
+        (Rectangle){0,0,CACHE_W,CACHE_H},(Vector2){0,0},0.0f,WHITE);
+    int n=INPUT_NEURONS+1;
+
     const char *il[]={"bias","in:0","in:1","in:2","in:3","in:4","in:5"};
     for(int i=0;i<n;i++){
         int hi=(sel_layer==0&&sel_idx==i), hov=(hov_layer==0&&hov_idx==i);
@@ -335,11 +475,6 @@ void draw_network()
         int hi=(sel_layer==1&&sel_idx==i), hov=(hov_layer==1&&hov_idx==i);
         snprintf(lbl,sizeof(lbl),"h%d",i);
         draw_node(hid_pos[i],hid_act[i],C_HIDDEN,lbl,hi,hov);
-        if(show_ctx){
-            Vector2 tip={hid_pos[i].x+NR+1,hid_pos[i].y};
-            Vector2 end={(float)CTX_X-2,ctx_pos[i].y};
-            DrawLineEx(tip,end,0.5f,Fade(C_CTX,0.18f));
-        }
     }
 
     int winner=0;
@@ -353,12 +488,6 @@ void draw_network()
         DrawText(vl,(int)out_pos[i].x+NR+4,(int)out_pos[i].y-5,9,
             (i==winner&&demo_ready)?LIME:C_GRAY);
     }
-
-    /* Legend */
-    int lx=NX+8,ly=NY+NH+2;
-    DrawRectangle(lx,     ly,10,7,(Color){220,55,55,200}); DrawText("positive weight",lx+13,ly-1,9,C_GRAY);
-    DrawRectangle(lx+140, ly,10,7,(Color){55,55,220,200}); DrawText("negative weight",lx+153,ly-1,9,C_GRAY);
-    DrawText("brightest output = prediction",lx+290,ly-1,9,C_GRAY);
 }
 
 void draw_context()
@@ -389,7 +518,7 @@ void draw_fitness_graph()
 {
     draw_panel(RX,RY,RW,RH,"FITNESS OVER GENERATIONS");
     DrawText("1.0 = perfect predictions,  0.0 = completely wrong",RX+8,RY+28,11,C_GRAY);
-    int mx=RX+40,my=RY+48,mw=RW-52,mh=RH-68;
+    int mx=GX,my=GY,mw=GW,mh=GH;
     DrawLine(mx,my,mx,my+mh,C_BORDER);
     DrawLine(mx,my+mh,mx+mw,my+mh,C_BORDER);
     DrawText("1.0",RX+6,my-6,     10,C_GRAY);
@@ -397,24 +526,39 @@ void draw_fitness_graph()
     DrawText("0.0",RX+6,my+mh-6,  10,C_GRAY);
     DrawLine(mx,my+mh/2,mx+mw,my+mh/2,(Color){38,38,62,255});
     DrawText("gen 0",mx-10,my+mh+4,9,C_GRAY);
-    char gl[12]; snprintf(gl,sizeof(gl),"gen %d",GENERATIONS);
-    DrawText(gl,mx+mw-30,my+mh+4,9,C_GRAY);
 
-    if(fit_count<2){
+    /* the x axis covers GENERATIONS, or more if the run is longer */
+    int span=replaying?replay.gens:(fit_count>GENERATIONS?fit_count:GENERATIONS);
+    char gl[16]; snprintf(gl,sizeof(gl),"gen %d",span);
+    DrawText(gl,mx+mw-MeasureText(gl,9),my+mh+4,9,C_GRAY);
+
+    const float *curve=replaying?replay_curve:fit_history;
+    int points=replaying?replay_points:fit_count;
+    float per_point=replaying?(float)span/points:1.0f;  /* generations per curve point */
+
+    if(points<2){
         DrawText("Press SPACE to start",mx+mw/2-60,my+mh/2-8,13,C_GRAY);
     } else {
-        float xs=(float)mw/GENERATIONS, ys=(float)mh;
-        for(int i=1;i<fit_count;i++){
-            float x1=mx+(i-1)*xs, y1=my+mh-fit_history[i-1]*ys;
-            float x2=mx+i    *xs, y2=my+mh-fit_history[i]    *ys;
+        float xs=(float)mw/span*per_point, ys=(float)mh;
+        int step=points>mw?points/mw:1;  /* at most one segment per pixel */
+        for(int i=step;i<points;i+=step){
+            float x1=mx+(i-step)*xs, y1=my+mh-curve[i-step]*ys;
+            float x2=mx+i       *xs, y2=my+mh-curve[i]     *ys;
             DrawLineEx((Vector2){x1,y1},(Vector2){x2,y2},2.2f,GREEN);
         }
-        char fl[32]; snprintf(fl,sizeof(fl),"Best: %.4f",fit_history[fit_count-1]);
+        char fl[32]; snprintf(fl,sizeof(fl),"Best: %.4f",replaying?replay_stats.best:fit_history[fit_count-1]);
         DrawText(fl,RX+RW-140,RY+8,13,LIME);
     }
 
+    if(replaying){
+        int cx=mx+(int)((float)mw*replay_gen/span);
+        DrawLine(cx,my,cx,my+mh,YELLOW);
+        char cl[16]; snprintf(cl,sizeof(cl),"gen %d",replay_gen);
+        DrawText(cl,cx+4,my+2,10,YELLOW);
+    }
+
     /* Progress bar */
-    float prog=(float)current_gen/GENERATIONS;
+    float prog=replaying?(float)(replay_gen+1)/replay.gens:(float)current_gen/GENERATIONS;
     DrawRectangle(mx,my+mh+18,mw,8,(Color){30,30,50,255});
     DrawRectangle(mx,my+mh+18,(int)(mw*prog),8,(Color){60,180,100,200});
 }
@@ -528,7 +672,10 @@ void draw_status()
     DrawRectangle(0,SH-28,SW,28,(Color){16,16,30,255});
     DrawLine(0,SH-28,SW,SH-28,C_BORDER);
     char s[180];
-    if(done)
+    if(replaying)
+        snprintf(s,sizeof(s),"Replay gen %d / %d   best %.4f  mean %.4f   LEFT RIGHT step (SHIFT x100)   PGUP PGDN   HOME END   click graph   SPACE play",
+            replay_gen,replay.gens-1,replay_stats.best,replay_stats.mean);
+    else if(done)
         snprintf(s,sizeof(s),"Done. %d generations. Best fitness: %.4f   Press R to restart.",
             GENERATIONS,fit_history[fit_count-1]);
     else if(paused&&current_gen==0)
@@ -540,13 +687,39 @@ void draw_status()
         snprintf(s,sizeof(s),"Evolving — gen %d / %d    SPACE pause    R reset    H memory    [ ] neurons    + - speed    E edit sequence",
             current_gen,GENERATIONS);
     DrawText(s,10,SH-20,12,(Color){170,170,195,255});
+    char fps[40]; snprintf(fps,sizeof(fps),"%s kernel  %d FPS",step_isa,GetFPS());
+    DrawText(fps,SW-MeasureText(fps,12)-10,SH-20,12,C_GRAY);
+}
+
+/* Replay keys and graph scrubbing. Returns 1 if the mouse is on the graph. */
+int handle_replay_input()
+{
+    int shift=IsKeyDown(KEY_LEFT_SHIFT)||IsKeyDown(KEY_RIGHT_SHIFT);
+    int page=replay.gens/100>1?replay.gens/100:1;
+    int gen=replay_gen;
+    if(IsKeyPressed(KEY_RIGHT))     gen+=shift?100:1;
+    if(IsKeyPressed(KEY_LEFT))      gen-=shift?100:1;
+    if(IsKeyPressed(KEY_PAGE_DOWN)) gen+=page;
+    if(IsKeyPressed(KEY_PAGE_UP))   gen-=page;
+    if(IsKeyPressed(KEY_HOME))      gen=0;
+    if(IsKeyPressed(KEY_END))       gen=replay.gens-1;
+
+    Vector2 m=GetMousePosition();
+    int on_graph=m.x>=GX&&m.x<=GX+GW&&m.y>=GY&&m.y<=GY+GH+26;
+    if(on_graph&&IsMouseButtonDown(MOUSE_LEFT_BUTTON))
+        gen=(int)((m.x-GX)/GW*replay.gens);
+
+    if(gen!=replay_gen){ manual_input=-1; show_replay_gen(gen); }
+    return on_graph;
 }
 
 void handle_input()
 {
     if(IsKeyPressed(KEY_SPACE)){ paused=!paused; manual_input=-1; }
 
-    if(IsKeyPressed(KEY_R)){
+    int on_graph=replaying&&!editing_seq&&handle_replay_input();
+
+    if(IsKeyPressed(KEY_R)&&!replaying){
         current_gen=0; fit_count=0; done=0; demo_ready=0;
         paused=1; manual_input=-1; sel_layer=-1; sel_idx=-1;
         reset_ctx(); init_population(); recalc_layout();
@@ -557,11 +730,11 @@ void handle_input()
     if(IsKeyPressed(KEY_EQUAL))  { if(speed_level<2) speed_level++; }
     if(IsKeyPressed(KEY_MINUS))  { if(speed_level>0) speed_level--; }
 
-    if(IsKeyPressed(KEY_RIGHT_BRACKET)&&h_count<MAX_HIDDEN){
+    if(IsKeyPressed(KEY_RIGHT_BRACKET)&&h_count<MAX_HIDDEN&&!replaying){
         h_count++; current_gen=0; fit_count=0; done=0; demo_ready=0;
         paused=1; reset_ctx(); init_population(); recalc_layout();
     }
-    if(IsKeyPressed(KEY_LEFT_BRACKET)&&h_count>MIN_HIDDEN){
+    if(IsKeyPressed(KEY_LEFT_BRACKET)&&h_count>MIN_HIDDEN&&!replaying){
         h_count--; current_gen=0; fit_count=0; done=0; demo_ready=0;
         paused=1; reset_ctx(); init_population(); recalc_layout();
     }
@@ -590,9 +763,12 @@ void handle_input()
             custom_len=seq_cursor;
             for(int i=0;i<custom_len;i++) custom_seq[i]=seq_input[i]-'0';
             editing_seq=0;
-            /* Reset so network trains on new sequence */
-            current_gen=0; fit_count=0; done=0; demo_ready=0;
-            reset_ctx(); init_population();
+            if(replaying) show_replay_gen(replay_gen);  /* same network, new sequence */
+            else {
+                /* Reset so network trains on new sequence */
+                current_gen=0; fit_count=0; done=0; demo_ready=0;
+                reset_ctx(); init_population();
+            }
         }
         /* Cancel */
         if(IsKeyPressed(KEY_ESCAPE)) editing_seq=0;
@@ -616,7 +792,7 @@ void handle_input()
         }
     }
 
-    if(IsMouseButtonPressed(MOUSE_LEFT_BUTTON)){
+    if(IsMouseButtonPressed(MOUSE_LEFT_BUTTON)&&!on_graph){
         Vector2 m=GetMousePosition(); int found=0;
         for(int i=0;i<INPUT_NEURONS+1&&!found;i++)
             if(near_node(m,inp_pos[i])){ sel_layer=0; sel_idx=i; found=1; }
@@ -625,6 +801,7 @@ void handle_input()
         for(int i=0;i<OUTPUT_NEURONS&&!found;i++)
             if(near_node(m,out_pos[i])){ sel_layer=2; sel_idx=i; found=1; }
         if(!found){ sel_layer=-1; sel_idx=-1; }
+        edges_dirty=1;
     }
 
     {
@@ -640,31 +817,44 @@ void handle_input()
     }
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    srand((unsigned int)time(NULL));
+    ga_rng=rng_stream((uint64_t)time(NULL),0,0);
+    if(argc>1&&!open_replay(argv[1])) return 1;
     SetConfigFlags(FLAG_MSAA_4X_HINT|FLAG_WINDOW_HIGHDPI);
     InitWindow(SW,SH,"Elman RNN + Genetic Algorithm — Interactive Visualizer");
     SetTargetFPS(60);
+    Vector2 dpi=GetWindowScaleDPI();
+    edge_cache=LoadRenderTexture((int)(CACHE_W*dpi.x),(int)(CACHE_H*dpi.y));
+    SetTextureFilter(edge_cache.texture,TEXTURE_FILTER_BILINEAR);
     recalc_layout(); reset_ctx(); init_population();
+    if(replaying) show_replay_gen(0);
     float gen_timer=0.0f;
 
     while(!WindowShouldClose()){
         float dt=GetFrameTime();
         handle_input();
-        if(!paused&&!done){
+        if(replaying&&!paused){
+            gen_timer+=dt;
+            if(gen_timer>=speed_intervals[speed_level]){
+                gen_timer=0.0f;
+                if(replay_gen<replay.gens-1) show_replay_gen(replay_gen+1);
+                else paused=1;
+            }
+        } else if(!paused&&!done){
             gen_timer+=dt;
             if(gen_timer>=speed_intervals[speed_level]){
                 gen_timer=0.0f;
                 evaluate_population();
                 int best=find_best();
-                fit_history[fit_count++]=(float)population[best].fitness;
+                add_fitness((float)population[best].fitness);
                 run_demo(best);
                 reproduce();
                 current_gen++;
                 if(current_gen>=GENERATIONS) done=1;
             }
         }
+        refresh_edge_cache();
         BeginDrawing();
         ClearBackground(C_BG);
         draw_network();
@@ -675,6 +865,9 @@ int main()
         draw_status();
         EndDrawing();
     }
+    UnloadRenderTexture(edge_cache);
     CloseWindow();
+    if(replaying) history_close(&replay);
+    free(fit_history);
     return 0;
 }
\ No newline at end of file